@@ -8,6 +8,12 @@
 
 #include <assert.h>
 #include "CPU.h"
+#include "timing.h"
+#include "decode.h"
+#include "jit.h"
+#include "aot.h"
+#include "trace.h"
+#include "profile.h"
 
 //The Chip-8 font set includes numvers from 0 to 9, and ABCDEF
 //Only the first four bits are used for drawing a number or character
@@ -31,383 +37,255 @@ unsigned char mainFontset[80] = {
 	0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 };
 
-chipCPU mainCPU;
-
-void print_debug();
-
-void cpu_initialize() {
+void cpu_initialize(chipCPU *cpu) {
+	cpu_build_decode_table();
+	
 	//Init registers and memory once
 	//The program counter starts at 0x200, and that's where we'll load the program code
-	mainCPU.progCounter = 0x200;
-	mainCPU.currentOP = 0;		//Reset the current opcode
-	mainCPU.I = 0;				//Reset the index register
-	mainCPU.stackPointer = 0;	//Reset the stack pointer
-	mainCPU.drawFlag = false;
-	mainCPU.running = true;
+	cpu->progCounter = 0x200;
+	cpu->currentOP = 0;		//Reset the current opcode
+	cpu->I = 0;				//Reset the index register
+	cpu->stackPointer = 0;	//Reset the stack pointer
+	cpu->drawFlag = false;
+	cpu->dirtyRows = 0xFFFFFFFF;
+	cpu->running = true;
 	
 	//Clear the display
-	for (int i = 0; i < 2048; i++) {
-		mainCPU.display[i] = 0;
+	for (int i = 0; i < DISPLAY_HEIGHT; i++) {
+		cpu->display[i] = 0;
 	}
 	//Clear the stack
 	for (int i = 0; i < 16; i++) {
-		mainCPU.stack[i] = 0;
+		cpu->stack[i] = 0;
 	}
 	//Clear the registers V0-VF
 	for (int i = 0; i < 16; i++) {
-		mainCPU.V[i] = 0;
+		cpu->V[i] = 0;
 	}
 	//Clear the memory
 	for (int i = 0; i < 4096; i++) {
-		mainCPU.memory[i] = 0;
-	}
-	//Clear the key array
-	for (int i = 0; i < 16; i++) {
-		mainCPU.key[i] = 0;
+		cpu->memory[i] = 0;
 	}
+	//No keys held
+	cpu->keys = 0;
+	cpu->keysRead = false;
 	
 	//Load the fontset
 	for (int i = 0; i < 80; i++) {
-		mainCPU.memory[i] = mainFontset[i];
+		cpu->memory[i] = mainFontset[i];
 	}
+	//No translated code yet. Anything a previous run translated was freed by cpu_destroy().
+	cpu->jitEnabled = false;
+	cpu->jit = NULL;
+	cpu->trace = NULL;
+#ifdef CPU_PROFILE
+	cpu->profile = NULL;
+#endif
+	cpu_invalidate_code(cpu, 0, MEMORY_SIZE);
 	
 	//Reset timers
-	mainCPU.delay_timer = 0;
-	mainCPU.sound_timer = 0;
+	cpu->delay_timer = 0;
+	cpu->sound_timer = 0;
+	cpu->timerTick = 0;
+	cpu->timerMode = timerModeCycles;
+	cpu->cyclesPerTick = cyclesPerFrameNormal;
+	cpu->timerEpoch = 0;
+	cpu->cycles = 0;
+	cpu->cycleLimit = 0;
+	cpu->idleCycles = 0;
+	cpu->sideEffects = 0;
+	cpu->idle.pc = IDLE_NONE;
+	cpu->quiet = false;
+	cpu->quirks = quirksLegacy;
+	
+	//Same sequence for every instance, like rand() without srand()
+	cpu_set_seed(cpu, RNG_DEFAULT_SEED, 0);
 }
 
-void get_current_frame(char *buf, int count) {
-	memcpy(buf, mainCPU.display, count);
+void cpu_destroy(chipCPU *cpu) {
+	trace_stop(cpu);
+#ifdef CPU_PROFILE
+	profile_stop(cpu);
+#endif
+#ifdef CPU_JIT
+	jit_destroy(cpu);
+#endif
 }
 
-int cpu_load_rom(char *filepath) {
-	
-	FILE *inputFile = fopen(filepath, "rb");
-	if (!inputFile) {
-		return -1;
-	}
-	fseek(inputFile, 0L, SEEK_END);
-	long size = ftell(inputFile);
-	printf("%ld", size);
-	
-	//Check file size
+void get_current_frame(chipCPU *cpu, uint64_t *rows) {
+	memcpy(rows, cpu->display, sizeof(cpu->display));
+}
+
+int cpu_load_rom_buffer(chipCPU *cpu, const byte *buffer, long size) {
+	//Check size
 	if (size >= 4096 - 512) {
 		return -2;
 	}
-	unsigned char buffer[size];
-	
-	rewind(inputFile);
-	
-	for (int i = 0; i < sizeof(buffer); i++) {
-		buffer[i] = getc(inputFile);
-	}
-	
 	//Copy starting from 0x200 == 512, which is where the CPU starts execution
-	memcpy(mainCPU.memory + 512, buffer, sizeof(buffer));
+	memcpy(cpu->memory + 512, buffer, size);
+	cpu_invalidate_code(cpu, PROGRAM_START, (int)size);
 	return 0;
 }
 
-void cpu_emulate_cycle() {
-	//Fetch opcode
-	//Each opcode is two bytes, so we shift left by 8 to add zeros after the first byte
-	//Then AND the second byte to add it after the first byte
-	mainCPU.currentOP = mainCPU.memory[mainCPU.progCounter] << 8 | mainCPU.memory[mainCPU.progCounter + 1];
-	if (CPU_DEBUG) print_debug();
-	
-	//Decode opcode and execute
-	switch (mainCPU.currentOP & 0xF000) { //Compare the FIRST 4 bits
-		case 0x0000:
-			//In some cases the first 4 bits don't tell us the opcode, in that case check the last 4 bits
-			switch (mainCPU.currentOP & 0x000F) { //Compare the LAST 4 bits
-				case 0x0000: // 0x00E0: Clear the screen
-					//Execute
-					memset(mainCPU.display, 0x0, 64 * 32);
-					mainCPU.drawFlag = true;
-					mainCPU.progCounter += 2;
-					break;
-				case 0x000E: // 0x00EE: Return from subroutine
-					--mainCPU.stackPointer;
-					//Pop PC off the stack and continue executing
-					mainCPU.progCounter = mainCPU.stack[mainCPU.stackPointer];
-					break;
-				default:
-					printf("Unknown opcode [0x0000]: 0x%X\n", mainCPU.currentOP);
-					exit(-1);
-					break;
-			}
-			break;
-			
-		case 0x1000: // 0x1NNN: Jump to address NNN
-			//Don't increment the program counter because we're jumping to an address
-			//Autohalt, automatically hault execution if infinite loop is detected
-			if (AUTOHALT && ((mainCPU.progCounter & 0x0FFF) == (mainCPU.currentOP & 0x0FFF))) {
-				printf("Infinite loop detected, halting execution.\n");
-				mainCPU.running = false;
-			}
-			mainCPU.progCounter = mainCPU.currentOP & 0x0FFF;
-			break;
-			
-		case 0x2000: // 0x2NNN: Call subroutine at NNN
-			//Increment PC before saving it into stack, so when returning, we can just pop the PC and continue executing
-			mainCPU.progCounter += 2;
-			mainCPU.stack[mainCPU.stackPointer] = mainCPU.progCounter;
-			++mainCPU.stackPointer;
-			mainCPU.progCounter = mainCPU.currentOP & 0x0FFF;
-			break;
-			
-		case 0x3000: // 0x3XNN: Skip the next instruction if VX equals NN
-			if (mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] == (mainCPU.currentOP & 0x00FF))
-				mainCPU.progCounter += 4;
-			else
-				mainCPU.progCounter += 2;
-			break;
-			
-		case 0x4000: // 0x4XNN: Skip the next instruction if VX doesn't equal NN
-			if (mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] != (mainCPU.currentOP & 0x00FF))
-				mainCPU.progCounter += 4;
-			else
-				mainCPU.progCounter += 2;
-			break;
-			
-		case 0x5000: // 0x5XY0: Skip the next instruction if VX equals VY
-			if (mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] == mainCPU.V[(mainCPU.currentOP & 0x00F0) >> 4])
-				mainCPU.progCounter += 4;
-			else
-				mainCPU.progCounter += 2;
-			break;
-			
-		case 0x6000: // 0x6XNN: Set VX to NN
-			mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] = (mainCPU.currentOP & 0x00FF);
-			mainCPU.progCounter += 2;
-			break;
-			
-		case 0x7000: // 0x7XNN: Add NN to VX
-			mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] += (mainCPU.currentOP & 0x00FF);
-			mainCPU.progCounter += 2;
-			break;
-			
-		case 0x8000: //0x8000 has 9 different opcodes, so we check the last 4 bits again to see which one it is
-			switch (mainCPU.currentOP & 0x000F) {
-				case 0x0000: // 0x8XY0: Set VX to the value of VY
-					mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] = mainCPU.V[(mainCPU.currentOP & 0x00F0) >> 4];
-					mainCPU.progCounter += 2;
-					break;
-				case 0x0001: // 0x8XY1: Set VX to VX or VY
-					mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] = (mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] | mainCPU.V[(mainCPU.currentOP & 0x00F0) >> 4]);
-					mainCPU.progCounter += 2;
-					break;
-				case 0x0002: // 0x8XY2: Set VX to VX and VY
-					mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] = (mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] & mainCPU.V[(mainCPU.currentOP & 0x00F0) >> 4]);
-					mainCPU.progCounter += 2;
-					break;
-				case 0x0003: // 0x8XY3: Set VX to VX xor VY
-					mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] = (mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] ^ mainCPU.V[(mainCPU.currentOP & 0x00F0) >> 4]);
-					mainCPU.progCounter += 2;
-					break;
-				case 0x0004: // 0x8XY4: Add VY to VX. VF is set to 1 when there's a carry, and to 0 when there isn't
-					//Remember to set VF to carry if overflows
-					if (mainCPU.V[(mainCPU.currentOP & 0x00F0) >> 4] > (0xFF - mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8])) {
-						mainCPU.V[0xF] = 1; //carry
-					} else {
-						mainCPU.V[0xF] = 0;
-					}
-					mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] += mainCPU.V[(mainCPU.currentOP & 0x00F0) >> 4];
-					mainCPU.progCounter += 2;
-					break;
-				case 0x0005: // 0x8XY5: VY is subtracted from VX. VF is set to 0 when there's a borrow, and 1 when there isn't
-					if (mainCPU.V[(mainCPU.currentOP & 0x00F0) >> 4] > mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8]) {
-						mainCPU.V[0xF] = 0; //There is borrow
-					} else {
-						mainCPU.V[0xF] = 1; //There is no borrow
-					}
-					mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] -= mainCPU.V[(mainCPU.currentOP & 0x00F0) >> 4];
-					mainCPU.progCounter += 2;
-					break;
-				case 0x0006: // 0x8XY6: Shift VX right by one. VF is set to the value of the least significant bit of VX before the shift
-					mainCPU.V[0xF] = mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] & 0x1;
-					mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] >>= 1;
-					mainCPU.progCounter += 2;
-					break;
-				case 0x0007: // 0x8XY7: Set VX to VY minus VX. VF is set to 0 when there's a borrow, and 1 when there isn't
-					if (mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] > mainCPU.V[(mainCPU.currentOP & 0x00F0) >> 4]) {
-						mainCPU.V[0xF] = 0; //There is a borrow
-					} else {
-						mainCPU.V[0xF] = 1; //There is no borrow
-					}
-					mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] = mainCPU.V[(mainCPU.currentOP & 0x00F0) >> 4] - mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8];
-					mainCPU.progCounter += 2;
-					break;
-				case 0x000E: // 0x8XYE: Shift VX left by one. VF is set to the value of the most significant bit of VX before the shift
-					mainCPU.V[0xF] = mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] >> 7;
-					mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] <<= 1;
-					mainCPU.progCounter += 2;
-					break;
-					
-				default:
-					printf("Unknown opcode [0x8000]: 0x%X", mainCPU.currentOP);
-					exit(-1);
-					break;
-			}
-			break;
-		
-		case 0x9000: // 0x9XY0: Skip the next instruction if VX doesn't equal VY
-			if (mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] != mainCPU.V[(mainCPU.currentOP & 0x00F0) >> 4]) {
-				mainCPU.progCounter += 4;
-			} else {
-				mainCPU.progCounter += 2;
-			}
-			break;
-			
-		case 0xA000: // 0xANNN: Set I to the address NNN
-			mainCPU.I = mainCPU.currentOP & 0x0FFF;
-			mainCPU.progCounter += 2;
-			break;
-			
-		case 0xB000: // 0xBNNN: Jump to the address NNN plus V0
-			//FIXME: I don't think we increment here!
-			mainCPU.progCounter = (mainCPU.currentOP & 0x0FFF) + mainCPU.V[0];
-			break;
-		
-		case 0xC000: // 0xCXNN: Set VX to the result of a bitwise and operation on a random number and NN
-			mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] = (rand() % 0xFF) & (mainCPU.currentOP & 0x00FF);
-			mainCPU.progCounter += 2;
-			break;
-			
-		case 0xD000: { // 0xDXYN: Draw a sprite at coordinate (VX,VY) that has a width of 8px and a height of Npx. Each row of 8 pixels is read as bit-coded starting from mem location I; I value doesn't change after the execution of this instruction. As described above, VF is set to 1 if any screen pixels are flipped from set to unset when the sprite is drawn, and to 0 if that doesn't happen
-				unsigned short x = mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8];
-				unsigned short y = mainCPU.V[(mainCPU.currentOP & 0x00F0) >> 4];
-				unsigned short height = mainCPU.currentOP & 0x000F;
-				unsigned short pixel;
-				
-				mainCPU.V[0xF] = 0; //No collision by default
-				for (int yline = 0; yline < height; yline++) {
-					pixel = mainCPU.memory[mainCPU.I + yline];
-					for (int xline = 0; xline < 8; xline++) {
-						if ((pixel & (0x80 >> xline)) != 0) {
-							if (mainCPU.display[(x + xline + ((y + yline) * 64))] == 1) {
-								mainCPU.V[0xF] = 1; //Collision happened
-							}
-							mainCPU.display[((x + xline) % 64) + (((y + yline) % 32) * 64)] ^= 1;
-						}
-					}
-				}
-				
-				mainCPU.drawFlag = true; //We've altered the display array, therefore set drawflag to true to update the screen
-				mainCPU.progCounter += 2;
-			}
-			break;
-			
-		case 0xE000: //Input opcodes
-			switch (mainCPU.currentOP & 0x00FF) {
-				case 0x009E: // 0xEX9E: Skip the next instruction if the key stored in VX is pressed
-					if (mainCPU.key[mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8]] != 0) {
-						mainCPU.progCounter += 4;
-					} else {
-						mainCPU.progCounter += 2;
-					}
-					break;
-				case 0x00A1: // 0xEXA1: Skip the next instruction if the key stored in VX isn't pressed
-					if (mainCPU.key[mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8]] == 0) {
-						mainCPU.progCounter += 4;
-					} else {
-						mainCPU.progCounter += 2;
-					}
-					break;
-					
-				default:
-					printf("Unknown opcode [0xE000]: 0x%X", mainCPU.currentOP);
-					exit(-1);
-					break;
-			}
-			break;
-		
-		case 0xF000:
-			switch (mainCPU.currentOP & 0x00FF) {
-				case 0x0007: // 0xFX07: Set VX to the value of the delay timer
-					mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] = mainCPU.delay_timer;
-					mainCPU.progCounter += 2;
-					break;
-				case 0x000A: { // 0xFX0A: Wait for key press, then store in VX
-					bool keyPressed = false;
-					for (int i = 0; i < 16; i++) {
-						if (mainCPU.key[i] != 0) {
-							mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] = i;
-							keyPressed = true;
-						}
-					}
-					if (!keyPressed) {
-						return;
-					}
-					mainCPU.progCounter += 2;
-				}
-					break;
-				case 0x0015: // 0xFX15: Set the delay timer to VX
-					mainCPU.delay_timer = mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8];
-					mainCPU.progCounter += 2;
-					break;
-				case 0x0018: // 0xFX18: Set the sound timer to VX
-					mainCPU.sound_timer = mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8];
-					mainCPU.progCounter += 2;
-					break;
-				case 0x001E: // 0xFX1E: Add VX to I
-					if (mainCPU.I + mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] > 0xFFF) {
-						mainCPU.V[0xF] = 1;//Overflow
-					} else {
-						mainCPU.V[0xF] = 0;
-					}
-					mainCPU.I += mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8];
-					mainCPU.progCounter += 2;
-					break;
-				case 0x0029: // 0xFX29: Set I to the location of the sprite for the character in VX. Characters 0-F in hex are represented by a 4x5 font (mainFontset)
-					mainCPU.I = mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] * 0x5;
-					mainCPU.progCounter += 2;
-					break;
-				case 0x0033: // 0xFX33: Store the binary-coded decimal representation of VX, with the most significant of three digits at the address I, in the middle digit at I+1, and the least significant digit at I+2. So basically take the decimal representation of VX, place the hundreds digit in memory at I, tens digit at I+1, and ones at I+2
-					mainCPU.memory[mainCPU.I]	  =  mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] / 100;
-					mainCPU.memory[mainCPU.I + 1] = (mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] / 10) % 10;
-					mainCPU.memory[mainCPU.I + 2] = (mainCPU.V[(mainCPU.currentOP & 0x0F00) >> 8] % 100) % 10;
-					mainCPU.progCounter += 2;
-					break;
-				case 0x0055: // 0xFX55: Store V0 to VX (Including VX) in memory starting at address I
-					for (int i = 0; i <= ((mainCPU.currentOP & 0x0F00) >> 8); i++) {
-						mainCPU.memory[mainCPU.I + i] = mainCPU.V[i];
-					}
-					mainCPU.I += ((mainCPU.currentOP & 0x0F00) >> 8) + 1;
-					mainCPU.progCounter += 2;
-					break;
-				case 0x0065: // 0xFX65: Fill V0 to VX (Including VX) with values from memory starting at address I
-					for (int i = 0; i <= ((mainCPU.currentOP & 0x0F00) >> 8); i++) {
-						mainCPU.V[i] = mainCPU.memory[mainCPU.I + i];
-					}
-					mainCPU.progCounter += 2;
-					break;
-					
-				default:
-					printf("Unknown opcode: 0x%X\n", mainCPU.currentOP);
-					exit(-1);
-					break;
-			}
-			break;
-			
-		default:
-			printf("Unknown opcode: 0x%X\n", mainCPU.currentOP);
-			exit(-1);
-			break;
+//Drop cached decodes of any instruction overlapping the written range.
+//An instruction at address a covers a and a + 1, so a write to addr also hits the one starting at addr - 1
+void cpu_invalidate_code(chipCPU *cpu, int addr, int length) {
+	int first = addr - 1 < PROGRAM_START ? PROGRAM_START : addr - 1;
+	int last = addr + length > MEMORY_SIZE ? MEMORY_SIZE : addr + length;
+	for (int a = first; a < last; ++a) {
+		cpu->decodeCache[a - PROGRAM_START].handler = OP_NOT_DECODED;
+	}
+#ifdef CPU_JIT
+	jit_invalidate(cpu, addr, length);
+#endif
+#ifdef CPU_AOT
+	aot_invalidate(cpu, addr, length);
+#endif
+}
+
+//Fetch opcode
+//Each opcode is two bytes, so we shift left by 8 to add zeros after the first byte
+//Then OR the second byte to add it after the first byte
+static inline unsigned short fetch(chipCPU *cpu) {
+	cpu->currentOP = cpu->memory[cpu->progCounter] << 8 | cpu->memory[cpu->progCounter + 1];
+	cpu->cycles++;
+	if (cpu->trace) trace_instruction(cpu);
+	PROFILE_INSTRUCTION(cpu);
+	return cpu->currentOP;
+}
+
+#if defined(CPU_DISPATCH_TABLE) || defined(CPU_DISPATCH_THREADED)
+
+//Decoded instruction at PC. Program memory goes through the decode cache, so the common
+//case is a single load. Anything outside it (font area, runaway PC) is decoded every time.
+static inline struct instr fetch_decoded(chipCPU *cpu) {
+	unsigned int offset = cpu->progCounter - PROGRAM_START;
+	if (offset < MEMORY_SIZE - PROGRAM_START - 1) {
+		struct instr *cached = &cpu->decodeCache[offset];
+		if (cached->handler == OP_NOT_DECODED) {
+			*cached = cpu_decode(cpu->memory[cpu->progCounter] << 8 | cpu->memory[cpu->progCounter + 1]);
+		}
+		cpu->currentOP = cached->op;
+		cpu->cycles++;
+		if (cpu->trace) trace_instruction(cpu);
+		PROFILE_INSTRUCTION(cpu);
+		return *cached;
+	}
+	//Handler index comes from a 64K entry lookup table, operands are extracted up front
+	return cpu_decode(fetch(cpu));
+}
+
+#endif
+
+//One interpreter per quirk profile
+#define QUIRK_PROFILE quirksLegacy
+#include "interpreter.h"
+#undef QUIRK_PROFILE
+#define QUIRK_PROFILE quirksVIP
+#include "interpreter.h"
+#undef QUIRK_PROFILE
+#define QUIRK_PROFILE quirksCHIP48
+#include "interpreter.h"
+#undef QUIRK_PROFILE
+#define QUIRK_PROFILE quirksSCHIP
+#include "interpreter.h"
+#undef QUIRK_PROFILE
+#define QUIRK_PROFILE quirksModern
+#include "interpreter.h"
+#undef QUIRK_PROFILE
+
+#define PROFILE_EXECUTE(profile) [profile] = execute_##profile,
+#define PROFILE_INTERPRET(profile) [profile] = interpret_##profile,
+static void (*const executors[quirkProfileCount])(chipCPU *) = {
+	PROFILE_EXECUTE(quirksLegacy)
+	PROFILE_EXECUTE(quirksVIP)
+	PROFILE_EXECUTE(quirksCHIP48)
+	PROFILE_EXECUTE(quirksSCHIP)
+	PROFILE_EXECUTE(quirksModern)
+};
+static void (*const interpreters[quirkProfileCount])(chipCPU *) = {
+	PROFILE_INTERPRET(quirksLegacy)
+	PROFILE_INTERPRET(quirksVIP)
+	PROFILE_INTERPRET(quirksCHIP48)
+	PROFILE_INTERPRET(quirksSCHIP)
+	PROFILE_INTERPRET(quirksModern)
+};
+#undef PROFILE_EXECUTE
+#undef PROFILE_INTERPRET
+
+void cpu_emulate_cycle(chipCPU *cpu) {
+	executors[cpu->quirks](cpu);
+}
+
+
+void cpu_set_quirks(chipCPU *cpu, enum quirkProfile profile) {
+	if (profile < 0 || profile >= quirkProfileCount) return;
+	cpu->quirks = profile;
+#ifdef CPU_JIT
+	//Translated code follows the profile it was translated with
+	jit_flush(cpu);
+#endif
+}
+
+bool cpu_set_jit(chipCPU *cpu, bool enabled) {
+#ifdef CPU_JIT
+	cpu->jitEnabled = enabled;
+	return true;
+#else
+	return !enabled;
+#endif
+}
+
+//Traces and profiles come from the interpreter's fetch, compiled code runs without them
+static inline bool cpu_observed(chipCPU *cpu) {
+#ifdef CPU_PROFILE
+	if (cpu->profile) return true;
+#endif
+	return cpu->trace != NULL;
+}
+
+int cpu_run(chipCPU *cpu, int cycles) {
+	unsigned long long start = cpu->cycles;
+	cpu->cycleLimit = start + cycles;
+	//Keys may have changed since the last run, so a loop has to be seen idling again in this one
+	cpu->idle.pc = IDLE_NONE;
+#if defined(CPU_AOT)
+	if (cpu_observed(cpu)) {
+		interpreters[cpu->quirks](cpu);
+	} else {
+		aot_run(cpu);
 	}
+#else
+#ifdef CPU_JIT
+	if (cpu->jitEnabled && !cpu_observed(cpu)) {
+		jit_run(cpu);
+	} else
+#endif
+	interpreters[cpu->quirks](cpu);
+#endif
+	//Nothing to fast-forward into outside of a run
+	cpu->cycleLimit = cpu->cycles;
+	return (int)(cpu->cycles - start);
 }
 
 
-bool cpu_is_drawflag_set() {
-	if (mainCPU.drawFlag) {
-		mainCPU.drawFlag = false;
+bool cpu_is_drawflag_set(chipCPU *cpu) {
+	if (cpu->drawFlag) {
+		cpu->drawFlag = false;
 		return true;
 	} else {
 		return false;
 	}
 }
 
-bool cpu_has_halted() {
-	if (!mainCPU.running) {
+uint32_t cpu_take_dirty_rows(chipCPU *cpu) {
+	uint32_t rows = cpu->dirtyRows;
+	cpu->dirtyRows = 0;
+	return rows;
+}
+
+bool cpu_has_halted(chipCPU *cpu) {
+	if (!cpu->running) {
 		return true;
 	} else {
 		return false;
@@ -415,201 +293,114 @@ bool cpu_has_halted() {
 }
 
 
-void cpu_set_keys(byte *keys) {
-	memcpy(mainCPU.key, keys, 16);
+void cpu_set_keys(chipCPU *cpu, uint16_t keys) {
+	cpu->keys = keys;
+}
+
+static unsigned long long current_tick(chipCPU *cpu) {
+	if (cpu->timerMode == timerModeWallClock) {
+		//Only read the clock when a timer is actually looked at
+		return (unsigned long long)(time_now_ns() - cpu->timerEpoch) * 60 / NSEC_PER_SEC;
+	}
+	return cpu->cycles / cpu->cyclesPerTick;
+}
+
+void cpu_set_timer_mode(chipCPU *cpu, enum timerMode mode, unsigned int cyclesPerTick) {
+	//Settle the timers on the old clock before switching
+	cpu_update_timers(cpu);
+	cpu->timerMode = mode;
+	cpu->cyclesPerTick = cyclesPerTick ? cyclesPerTick : 1;
+	cpu->timerEpoch = time_now_ns();
+	cpu->timerTick = current_tick(cpu);
+}
+
+void cpu_set_seed(chipCPU *cpu, uint64_t seed, uint64_t stream) {
+	rng_seed(&cpu->rngState, &cpu->rngIncrement, seed, stream);
 }
 
-void cpu_decrement_counters() {
-	if (mainCPU.delay_timer != 0) {
-		mainCPU.delay_timer--;
+//Count the timers down by however many ticks passed since they were last updated.
+//Called by the scheduler once a frame, and before any opcode that touches a timer.
+void cpu_update_timers(chipCPU *cpu) {
+	unsigned long long now = current_tick(cpu);
+	unsigned long long elapsed = now - cpu->timerTick;
+	if (elapsed == 0) return;
+	cpu->timerTick = now;
+	
+	if (cpu->delay_timer != 0) {
+		cpu->delay_timer = elapsed >= cpu->delay_timer ? 0 : cpu->delay_timer - elapsed;
 	}
-	if (mainCPU.sound_timer != 0) {
-		if (mainCPU.sound_timer == 1)
-			printf("BEEP!\n"); //TODO: Make this beep :D
-		mainCPU.sound_timer--;
+	if (cpu->sound_timer != 0) {
+		if (elapsed >= cpu->sound_timer) {
+			if (!cpu->quiet) printf("BEEP!\n"); //TODO: Make this beep :D
+			cpu->sound_timer = 0;
+		} else {
+			cpu->sound_timer -= elapsed;
+		}
 	}
 }
 
-//Debug logger
-void print_debug() {
-	//Print progCounter
-	printf("PC:0x%X", mainCPU.progCounter);
-	//Print current op
-	printf(" OP: 0x%X ", mainCPU.currentOP);
-	//Decode and print what op does
+//Idle loops, like FX07 3X00 1NNN waiting for the delay timer, spend most of a frame going around
+//without changing anything. When a backward jump finds the machine exactly as it was the last time
+//it got there, with nothing written or drawn in between, the next iterations would play out the same
+//until the delay timer ticks. So those are skipped by just adding their cycles.
+//Timers are derived from cycles, so this gives the same results as running them.
+void cpu_idle_jump(chipCPU *cpu, unsigned short pc) {
+	struct idleSnapshot *idle = &cpu->idle;
+	if (idle->pc != pc || idle->sideEffects != cpu->sideEffects || idle->I != cpu->I ||
+		idle->stackPointer != cpu->stackPointer || idle->rngState != cpu->rngState ||
+		memcmp(idle->V, cpu->V, sizeof(idle->V)) != 0) {
+		idle->pc = pc;
+		memcpy(idle->V, cpu->V, sizeof(idle->V));
+		idle->I = cpu->I;
+		idle->stackPointer = cpu->stackPointer;
+		idle->rngState = cpu->rngState;
+		idle->sideEffects = cpu->sideEffects;
+		idle->cycles = cpu->cycles;
+		idle->timed = false;
+		return;
+	}
 	
-	switch (mainCPU.currentOP & 0xF000) { //Compare the FIRST 4 bits
-		case 0x0000:
-			//In some cases the first 4 bits don't tell us the opcode, in that case check the last 4 bits
-			switch (mainCPU.currentOP & 0x000F) {//Compare the LAST 4 bits
-				case 0x0000: // 0x00E0: Clear the screen
-					printf("0x00E0: Clear the screen");
-					break;
-				case 0x000E: // 0x00EE: Return from subroutine
-					printf("0x00EE: Return from subroutine");
-					break;
-					
-				default:
-					printf("Unknown opcode [0x0000]: 0x%X\n", mainCPU.currentOP);
-					exit(-1);
-					break;
-			}
-			break;
-			
-		case 0x1000: // 0x1NNN: Jump to address NNN
-			printf("0x1NNN: Jump to address NNN");
-			break;
-			
-		case 0x2000: // 0x2NNN: Call subroutine at NNN
-			printf("0x2NNN: Call subroutine at NNN");
-			break;
-			
-		case 0x3000: // 0x3XNN: Skip the next instruction if VX equals NN
-			printf("0x3XNN: Skip the next instruction if VX equals NN");
-			break;
-			
-		case 0x4000: // 0x4XNN: Skip the next instruction if VX doesn't equal NN
-			printf("0x4XNN: Skip the next instruction if VX doesn't equal NN");
-			break;
-			
-		case 0x5000: // 0x5XY0: Skip the next instruction if VX equals VY
-			printf("0x5XY0: Skip the next instruction if VX equals VY");
-			break;
-			
-		case 0x6000: // 0x6XNN: Set VX to NN
-			printf("0x6XNN: Set VX to NN");
-			break;
-			
-		case 0x7000: // 0x7XNN: Add NN to VX
-			printf("0x7XNN: Add NN to VX");
-			break;
-			
-		case 0x8000: //0x8000 has 9 different opcodes, so we check the last 4 bits again to see which one it is
-			switch (mainCPU.currentOP & 0x000F) {
-				case 0x0000: // 0x8XY0: Set VX to the value of VY
-					printf("0x8XY0: Set VX to the value of VY");
-					break;
-				case 0x0001: // 0x8XY1: Set VX to VX or VY
-					printf("0x8XY1: Set VX to VX or VY");
-					break;
-				case 0x0002: // 0x8XY2: Set VX to VX and VY
-					printf("0x8XY2: Set VX to VX and VY");
-					break;
-				case 0x0003: // 0x8XY3: Set VX to VX xor VY
-					printf("0x8XY3: Set VX to VX xor VY");
-					break;
-				case 0x0004: // 0x8XY4: Add VY to VX. VF is set to 1 when there's a carry, and to 0 when there isn't
-					printf("0x8XY4: Add VY to VX. VF is set to 1 when there's a carry, and to 0 when there isn't");
-					break;
-				case 0x0005: // 0x8XY5: VY is subtracted from VX. VF is set to 0 when there's a borrow, and 1 when there isn't
-					printf("0x8XY5: VY is subtracted from VX. VF is set to 0 when there's a borrow, and 1 when there isn't");
-					break;
-				case 0x0006: // 0x8XY6: Shift VX right by one. VF is set to the value of the least significant bit of VX before the shift
-					printf("0x8XY6: Shift VX right by one. VF is set to the value of the least significant bit of VX before the shift");
-					break;
-				case 0x0007: // 0x8XY7: Set VX to VY minus VX. VF is set to 0 when there's a borrow, and 1 when there isn't
-					printf("0x8XY7: Set VX to VY minus VX. VF is set to 0 when there's a borrow, and 1 when there isn't");
-					break;
-				case 0x000E: // 0x8XYE: Shift VX left by one. VF is set to the value of the most significant bit of VX before the shift
-					printf("0x8XYE: Shift VX left by one. VF is set to the value of the most significant bit of VX before the shift");
-					break;
-					
-				default:
-					printf("Unknown opcode [0x8000]: 0x%X", mainCPU.currentOP);
-					exit(0);
-					break;
-			}
-			break;
-			
-		case 0x9000: // 0x9XY0: Skip the next instruction if VX doesn't equal VY
-			printf("0x9XY0: Skip the next instruction if VX doesn't equal VY");
-			break;
-			
-		case 0xA000: // 0xANNN: Set I to the address NNN
-			printf("0xANNN: Set I to the address NNN");
-			break;
-			
-		case 0xB000: // 0xBNNN: Jump to the address NNN plus V0
-			printf("0xBNNN: Jump to the address NNN plus V0");
-			break;
-			
-		case 0xC000: // 0xCXNN: Set VX to the result of a bitwise and operation on a random number and NN
-			printf("0xCXNN: Set VX to the result of a bitwise and operation on a random number and NN");
-			break;
-			
-		case 0xD000: // 0xDXYN: Draw a sprite at coordinate (VX,VY) that has a width of 8px and a height of Npx. Each row of 8 pixels is read as bit-coded starting from mem location I; I value doesn't change after the execution of this instruction. As described above, VF is set to 1 if any screen pixels are flipped from set to unset when the sprite is drawn, and to 0 if that doesn't happen
-			printf("0xDXYN: Draw a sprite at coordinate (VX,VY) that has a width of 8px and a height of Npx");
-			break;
-			
-		case 0xE000: //Input opcodes
-			switch (mainCPU.currentOP & 0x00FF) {
-				case 0x009E: // 0xEX9E: Skip the next instruction if the key stored in VX is pressed
-					printf("0xEX9E: Skip the next instruction if the key stored in VX is pressed");
-					break;
-				case 0x00A1: // 0xEXA1: Skip the next instruction if the key stored in VX isn't pressed
-					printf("0xEXA1: Skip the next instruction if the key stored in VX isn't pressed");
-					break;
-					
-				default:
-					printf("Unknown opcode [0xE000]: 0x%X", mainCPU.currentOP);
-					exit(-1);
-					break;
-			}
-			break;
-			
-		case 0xF000:
-			switch (mainCPU.currentOP & 0x00FF) {
-				case 0x0007: // 0xFX07: Set VX to the value of the delay timer
-					printf("0xFX07: Set VX to the value of the delay timer");
-					break;
-				case 0x000A: // 0xFX0A: Wait for key press, then store in VX
-					printf("0xFX0A: Wait for key press, then store in VX");
-					break;
-				case 0x0015: // 0xFX15: Set the delay timer to VX
-					printf("0xFX15: Set the delay timer to VX");
-					break;
-				case 0x0018: // 0xFX18: Set the sound timer to VX
-					printf("0xFX18: Set the sound timer to VX");
-					break;
-				case 0x001E: // 0xFX1E: Add VX to I
-					printf("0xFX1E: Add VX to I");
-					break;
-				case 0x0029: // 0xFX29: Set I to the location of the sprite for the character in VX. Characters 0-F in hex are represented by a 4x5 font (mainFontset)
-					printf("0xFX29: Set I to the location of the sprite for the character in VX");
-					break;
-				case 0x0033: // 0xFX33: Store the binary-coded decimal representation of VX, with the most significant of three digits at the address I, in the middle digit at I+1, and the least significant digit at I+2. So basically take the decimal representation of VX, place the hundreds digit in memory at I, tens digit at I+1, and ones at I+2
-					printf("0xFX33: Store the binary-coded decimal representation of VX");
-					break;
-				case 0x0055: // 0xFX55: Store V0 to VX (Including VX) in memory starting at address I
-					printf("0xFX55: Store V0 to VX (Including VX) in memory starting at address I");
-					break;
-				case 0x0065: // 0xFX65: Fill V0 to VX (Including VX) with values from memory starting at address I
-					printf("0xFX65: Fill V0 to VX (Including VX) with values from memory starting at address I");
-					break;
-					
-				default:
-					printf("Unknown opcode: 0x%X\n", mainCPU.currentOP);
-					exit(-1);
-					break;
-			}
-			break;
-			
-		default:
-			printf("Unknown opcode: 0x%X\n", mainCPU.currentOP);
-			exit(-1);
-			break;
+	//Same state again. Only look at the timers now, that can mean reading the clock.
+	cpu_update_timers(cpu);
+	unsigned long long now = cpu->cycles;
+	unsigned long long length = now - idle->cycles;
+	idle->cycles = now;
+	if (!idle->timed || length == 0) {
+		idle->timerTick = cpu->timerTick;
+		idle->delay = cpu->delay_timer;
+		idle->timed = true;
+		return;
+	}
+	//The last iteration has to have seen one delay timer value throughout
+	bool delayStopped = idle->delay == 0;
+	if (!delayStopped && idle->timerTick != cpu->timerTick) {
+		idle->timerTick = cpu->timerTick;
+		idle->delay = cpu->delay_timer;
+		return;
 	}
 	
-	//Add newline
-	printf("\n");
+	unsigned long long end = cpu->cycleLimit;
+	if (!delayStopped) {
+		//Running, but with cycle timers the next tick is a known cycle. Stay an iteration clear of it.
+		if (cpu->timerMode != timerModeCycles) return;
+		unsigned long long tick = (cpu->timerTick + 1) * cpu->cyclesPerTick;
+		if (tick < end) end = tick;
+		if (end < now + length) return;
+		end -= length;
+	}
+	if (end <= now) return;
+	unsigned long long skipped = (end - now) / length * length;
+	cpu->cycles += skipped;
+	cpu->idleCycles += skipped;
+	idle->cycles = cpu->cycles;
+	PROFILE_IDLE(cpu, pc, skipped);
 }
 
-
-
-
-
-
-
-
-
-
+void cpu_idle_key_wait(chipCPU *cpu) {
+	//Keys only change between runs, so nothing will happen for the rest of this one
+	if (cpu->cycleLimit > cpu->cycles) {
+		PROFILE_IDLE(cpu, cpu->progCounter, cpu->cycleLimit - cpu->cycles);
+		cpu->idleCycles += cpu->cycleLimit - cpu->cycles;
+		cpu->cycles = cpu->cycleLimit;
+	}
+}
@@ -12,25 +12,86 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <memory.h>
 #include <signal.h>
+#include "quirks.h"
+#include "rng.h"
+
+//Instruction dispatch engine, picked with -DCPU_DISPATCH=switch|table|threaded in CMake.
+//switch:   Nested switch on the opcode nibbles
+//table:    64K entry opcode -> handler table, called through function pointers
+//threaded: Same table, with handlers chained through computed gotos (GCC/Clang only, falls back to switch)
+#if defined(CPU_DISPATCH_THREADED) && !defined(__GNUC__)
+#undef CPU_DISPATCH_THREADED
+#endif
+
+//x86-64 basic block recompiler, built with -DCPU_JIT=ON in CMake and turned on at runtime with cpu_set_jit()
+#if defined(CPU_JIT) && (!defined(__x86_64__) || defined(WINDOWS))
+#undef CPU_JIT
+#endif
 
 #define AUTOHALT false
-//CPU debug mode prints a log of opcodes
-#define CPU_DEBUG false
-//If CPU debug and delayEnabled is true, use delayDebug
-#define delayEnabled false
 
-#define delayNormal 2
-#define delayDebug  200
+//Instructions run per 60Hz frame
+#define cyclesPerFrameNormal 10
 
 typedef unsigned char byte;
 
+#define DISPLAY_WIDTH 64
+#define DISPLAY_HEIGHT 32
+
+//Timers count down at 60Hz. By default a tick is a fixed number of emulated cycles,
+//which makes timer behaviour reproducible between runs. Wall clock mode derives ticks
+//from the host's monotonic clock instead.
+enum timerMode {
+	timerModeCycles,
+	timerModeWallClock
+};
+
+//An instruction with its handler index (see decode.h) and operands already extracted
+struct instr {
+	unsigned short op;
+	byte handler;
+	byte x;
+	byte y;
+	byte nn; //The low nibble of this is N
+	unsigned short nnn;
+};
+
 //Chip-8 memory map
 // 0x000-0x1FF Chip 8 interpreter, contains font set
 // 0x050-0x0A0 Used for the built in font set from 0-F
 // 0x200-0xFFF Program ROM and work RAM
+#define PROGRAM_START 0x200
+#define MEMORY_SIZE 4096
+
+//Translated code for one CPU, see jit.c
+struct jitState;
+//Hot-spot counters, see profile.h
+struct profiler;
+//Execution trace being written, see trace.h
+struct tracer;
+
+//No loop being watched by the idle detector
+#define IDLE_NONE 0xFFFF
+
+//Machine state the last time a backward jump was taken, see cpu_idle_jump()
+struct idleSnapshot {
+	unsigned short pc; //Address of the jump, IDLE_NONE if there's no snapshot
+	byte V[16];
+	unsigned short I;
+	unsigned short stackPointer;
+	uint64_t rngState;
+	unsigned int sideEffects;
+	unsigned long long cycles;
+	//Timer state from the second matching arrival on
+	bool timed;
+	unsigned long long timerTick;
+	byte delay;
+};
 
+//Everything a machine needs lives in here, so separate instances share nothing and can run on separate threads
 typedef struct {
 	unsigned short currentOP;   //2 bytes
 	byte memory[4096]; //4KB
@@ -39,9 +100,12 @@ typedef struct {
 	unsigned short progCounter; //Program counter, from 0x000 to 0xFFF
 	
 	//Graphics, a 64x32 1 bit bitmap, 2048 pixels
-	byte display[64 * 32];
+	//One 64 bit word per row, the most significant bit is the leftmost pixel
+	uint64_t display[DISPLAY_HEIGHT];
 	//Draw flag, set to true if screen needs to be updated
 	bool drawFlag;
+	//Rows drawn to since cpu_take_dirty_rows() was last called, bit n is row n
+	uint32_t dirtyRows;
 	//Running flag, set to false when an infinite loop is detected.
 	//This isn't standard CHIP-8 behavior, but rather useful.
 	bool running;
@@ -49,6 +113,31 @@ typedef struct {
 	//No interrupts or hardware registers, only two timer registers that count down to 0 at 60hz
 	byte delay_timer; //Used for delays
 	byte sound_timer; //Used for sound, system buzzer sounds when this reaches 0
+	//Timers are brought up to date lazily, this is the tick they were last updated on
+	unsigned long long timerTick;
+	enum timerMode timerMode;
+	unsigned int cyclesPerTick;
+	long long timerEpoch; //Wall clock mode only, ns
+	
+	//Don't print beeps or unknown opcodes, for batch runs
+	bool quiet;
+	
+	//Which behaviour ambiguous instructions follow, picks the interpreter cpu_run() uses
+	enum quirkProfile quirks;
+	
+	//Cycles executed since cpu_initialize()
+	unsigned long long cycles;
+	//cpu_run() stops once cycles reaches this
+	unsigned long long cycleLimit;
+	//Of those cycles, how many were fast-forwarded over by the idle detector instead of run
+	unsigned long long idleCycles;
+	//Bumped by every instruction that writes memory, draws or sets a timer
+	unsigned int sideEffects;
+	struct idleSnapshot idle;
+	
+	//PCG32 state and stream for CXNN, see rng.h
+	uint64_t rngState;
+	uint64_t rngIncrement;
 	
 	//Stack
 	//Some opcodes can jump to a mem location or call a subroutine
@@ -57,19 +146,67 @@ typedef struct {
 	unsigned short stack[16];
 	unsigned short stackPointer;
 	
+	//Decoded instructions for program memory, indexed by address - PROGRAM_START.
+	//Filled in the first time an address is executed, and cleared when the program writes over it.
+	struct instr decodeCache[MEMORY_SIZE - PROGRAM_START];
+	
+	//Run through the recompiler instead of the interpreter. Its state is allocated on first use.
+	bool jitEnabled;
+	struct jitState *jit;
+	
+	//Binary execution trace, NULL unless one is being written (see trace.h)
+	struct tracer *trace;
+#ifdef CPU_PROFILE
+	//Hot-spot counters, NULL unless profiling (see profile.h)
+	struct profiler *profile;
+#endif
+#ifdef CPU_AOT
+	//Compiled blocks, indexed by start address - PROGRAM_START, that the ROM has since written over
+	bool aotBlockModified[MEMORY_SIZE - PROGRAM_START];
+#endif
+	
 	//Input
-	//Chip 8 has a hex keypad with 16 keys, 0x0-0xF, this is an array to store the current state of the key
-	byte key[16];
+	//Chip 8 has a hex keypad with 16 keys, 0x0-0xF. Bit n is set while key n is held down.
+	uint16_t keys;
+	//Set whenever EX9E, EXA1 or FX0A looks at them, for measuring input latency
+	bool keysRead;
 } chipCPU;
 
-void cpu_initialize();
-int cpu_load_rom(char *filepath);
-void cpu_emulate_cycle();
-void get_current_frame(char *buf, int count);
-bool cpu_is_drawflag_set();
-bool cpu_has_halted();
-void cpu_set_keys(byte *keys);
-void cpu_decrement_counters(void);
+void cpu_initialize(chipCPU *cpu);
+//Free anything the CPU allocated on its own, like translated code. The chipCPU itself is left alone.
+void cpu_destroy(chipCPU *cpu);
+int cpu_load_rom_buffer(chipCPU *cpu, const byte *buffer, long size);
+void cpu_emulate_cycle(chipCPU *cpu);
+//Run up to cycles instructions, stopping early if the CPU halts. Returns the number executed,
+//which includes idle loop iterations that were fast-forwarded (see cpu_idle_jump()).
+int cpu_run(chipCPU *cpu, int cycles);
+//Switch cpu_run() between the interpreter and the recompiler. Returns false if the JIT isn't built in.
+bool cpu_set_jit(chipCPU *cpu, bool enabled);
+void get_current_frame(chipCPU *cpu, uint64_t *rows);
+bool cpu_is_drawflag_set(chipCPU *cpu);
+uint32_t cpu_take_dirty_rows(chipCPU *cpu);
+bool cpu_has_halted(chipCPU *cpu);
+void cpu_set_keys(chipCPU *cpu, uint16_t keys);
+void cpu_invalidate_code(chipCPU *cpu, int addr, int length);
+void cpu_set_timer_mode(chipCPU *cpu, enum timerMode mode, unsigned int cyclesPerTick);
+void cpu_set_quirks(chipCPU *cpu, enum quirkProfile profile);
+//Restart the CXNN random number generator from seed, on the given stream
+void cpu_set_seed(chipCPU *cpu, uint64_t seed, uint64_t stream);
+void cpu_update_timers(chipCPU *cpu);
+//Called after the jump at pc went backwards. Fast-forwards cycles if the loop is only waiting.
+void cpu_idle_jump(chipCPU *cpu, unsigned short pc);
+//FX0A with no key pressed, skips the rest of the run
+void cpu_idle_key_wait(chipCPU *cpu);
+
+//Keys past F don't exist, so they're never pressed
+static inline bool cpu_key_pressed(chipCPU *cpu, byte key) {
+	cpu->keysRead = true;
+	return key < 16 && (cpu->keys >> key & 1);
+}
+
+static inline uint32_t cpu_random(chipCPU *cpu) {
+	return rng_next(&cpu->rngState, cpu->rngIncrement);
+}
 
 
 #endif /* CPU_h */
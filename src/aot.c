@@ -0,0 +1,266 @@
+//
+//  aot.c
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+//chip8-aot, a static recompiler from a ROM to a C translation unit.
+//Code reachable from 0x200 through jumps, calls, skips and fallthrough is split into basic blocks,
+//and each block becomes a label in aot_run() calling the same instruction handlers (ops.h) the
+//interpreter uses, with constant operands. Static control flow jumps straight to the next label.
+//Returns, BNNN and FX0A go through a switch on PC, and anything without a label (indirect jump
+//targets, code the ROM rewrote at runtime) is run by the interpreter.
+//Handlers are instantiated for one quirk profile, picked with --quirks.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "decode.h"
+
+static byte memory[MEMORY_SIZE];
+static int romSize;
+static enum quirkProfile profile = quirksLegacy;
+//What the generated code passes as QUIRK_PROFILE
+static const char *quirkEnumNames[quirkProfileCount] = {
+	[quirksLegacy] = "quirksLegacy",
+	[quirksVIP] = "quirksVIP",
+	[quirksCHIP48] = "quirksCHIP48",
+	[quirksSCHIP] = "quirksSCHIP",
+	[quirksModern] = "quirksModern",
+};
+
+static bool isCode[MEMORY_SIZE];
+static bool isLeader[MEMORY_SIZE];
+
+static unsigned short opcode_at(int addr) {
+	return memory[addr] << 8 | memory[addr + 1];
+}
+
+static bool in_rom(int addr) {
+	return addr >= PROGRAM_START && addr + 1 < PROGRAM_START + romSize;
+}
+
+static bool is_skip(enum opHandler h) {
+	return h == OP_3XNN || h == OP_4XNN || h == OP_5XY0 || h == OP_9XY0 || h == OP_EX9E || h == OP_EXA1;
+}
+
+//Instructions that end a basic block
+static bool ends_block(enum opHandler h) {
+	switch (h) {
+		case OP_1NNN:
+		case OP_2NNN:
+		case OP_00EE:
+		case OP_BNNN:
+		case OP_FX0A:
+		//Writes to memory end a block, so the next block's entry check sees self-modified code
+		case OP_FX33:
+		case OP_FX55:
+			return true;
+		default:
+			return is_skip(h);
+	}
+}
+
+static int worklist[MEMORY_SIZE * 4];
+static int worklistCount = 0;
+
+static void add_target(int addr) {
+	if (!in_rom(addr)) return;
+	isLeader[addr] = true;
+	if (!isCode[addr]) worklist[worklistCount++] = addr;
+}
+
+//Walk everything reachable from 0x200
+static void analyse() {
+	add_target(PROGRAM_START);
+	while (worklistCount) {
+		int addr = worklist[--worklistCount];
+		while (in_rom(addr) && !isCode[addr]) {
+			unsigned short op = opcode_at(addr);
+			enum opHandler h = cpu_decode_handler(op);
+			//Probably data we ran into, the interpreter will deal with it if it's ever executed
+			if (h == OP_UNKNOWN) break;
+			isCode[addr] = true;
+
+			if (h == OP_1NNN) {
+				add_target(op & 0x0FFF);
+				break;
+			}
+			if (h == OP_2NNN) {
+				add_target(op & 0x0FFF);
+				add_target(addr + 2);
+				break;
+			}
+			if (is_skip(h)) {
+				add_target(addr + 2);
+				add_target(addr + 4);
+				break;
+			}
+			if (h == OP_FX0A) {
+				add_target(addr);
+				add_target(addr + 2);
+				break;
+			}
+			if (h == OP_00EE || h == OP_BNNN) break;
+			if (ends_block(h)) {
+				add_target(addr + 2);
+				break;
+			}
+			addr += 2;
+		}
+	}
+}
+
+static void emit_goto(FILE *out, int addr) {
+	if (in_rom(addr) && isLeader[addr] && isCode[addr]) {
+		fprintf(out, "goto block_%03X;\n", addr);
+	} else {
+		fprintf(out, "goto dispatch;\n");
+	}
+}
+
+static int generate(FILE *out, const char *romName) {
+	int blockCount = 0;
+	static int blockStarts[MEMORY_SIZE];
+	static int blockEnds[MEMORY_SIZE];
+	for (int addr = PROGRAM_START; addr < PROGRAM_START + romSize; ++addr) {
+		if (!isLeader[addr] || !isCode[addr]) continue;
+		int end = addr;
+		do {
+			enum opHandler h = cpu_decode_handler(opcode_at(end));
+			end += 2;
+			if (ends_block(h)) break;
+		} while (isCode[end] && !isLeader[end]);
+		blockStarts[blockCount] = addr;
+		blockEnds[blockCount] = end;
+		blockCount++;
+	}
+
+	fprintf(out, "//Generated by chip8-aot from %s, do not edit.\n\n", romName);
+	fprintf(out, "#define QUIRK_PROFILE %s\n", quirkEnumNames[profile]);
+	fprintf(out, "#include \"ops.h\"\n#include \"aot.h\"\n\n");
+	fprintf(out, "#define INSTR(op) ((struct instr){ (op), 0, ((op) & 0x0F00) >> 8, ((op) & 0x00F0) >> 4, (op) & 0x00FF, (op) & 0x0FFF })\n\n");
+	fprintf(out, "const char *aotRomName = \"%s\";\n", romName);
+	fprintf(out, "const long aotRomSize = %d;\n", romSize);
+	fprintf(out, "const enum quirkProfile aotQuirks = QUIRK_PROFILE;\n");
+	fprintf(out, "const byte aotRom[] = {");
+	for (int i = 0; i < romSize; ++i) {
+		fprintf(out, "%s0x%02X,", i % 16 ? " " : "\n\t", memory[PROGRAM_START + i]);
+	}
+	fprintf(out, "\n};\n\n");
+
+	fprintf(out, "#define BLOCK_COUNT %d\n\n", blockCount ? blockCount : 1);
+	fprintf(out, "static const unsigned short blockStart[BLOCK_COUNT] = {");
+	for (int b = 0; b < blockCount; ++b) fprintf(out, "%s0x%03X,", b % 12 ? " " : "\n\t", blockStarts[b]);
+	fprintf(out, "\n};\n");
+	fprintf(out, "static const unsigned short blockEnd[BLOCK_COUNT] = {");
+	for (int b = 0; b < blockCount; ++b) fprintf(out, "%s0x%03X,", b % 12 ? " " : "\n\t", blockEnds[b]);
+	fprintf(out, "\n};\n");
+	fprintf(out, "\n");
+
+	fprintf(out,
+			"//Flag blocks the ROM has written over, so they no longer match what we compiled\n"
+			"void aot_invalidate(chipCPU *cpu, int addr, int length) {\n"
+			"\tfor (int b = 0; b < BLOCK_COUNT; ++b) {\n"
+			"\t\tif (addr >= blockEnd[b] || addr + length <= blockStart[b]) continue;\n"
+			"\t\tcpu->aotBlockModified[blockStart[b] - PROGRAM_START] = memcmp(cpu->memory + blockStart[b], aotRom + blockStart[b] - PROGRAM_START, blockEnd[b] - blockStart[b]) != 0;\n"
+			"\t}\n"
+			"}\n\n");
+
+	fprintf(out,
+			"void aot_run(chipCPU *cpu) {\n"
+			"dispatch:\n"
+			"\tif (cpu->cycles >= cpu->cycleLimit || !cpu->running) return;\n"
+			"\tswitch (cpu->progCounter) {\n");
+	for (int b = 0; b < blockCount; ++b) {
+		fprintf(out, "\t\tcase 0x%03X: goto block_%03X;\n", blockStarts[b], blockStarts[b]);
+	}
+	fprintf(out,
+			"\t\tdefault: goto interpret;\n"
+			"\t}\n"
+			"interpret:\n"
+			"\t//No translated block here, or it doesn't fit the budget\n"
+			"\tif (cpu->cycles >= cpu->cycleLimit || !cpu->running) return;\n"
+			"\tcpu_emulate_cycle(cpu);\n"
+			"\tgoto dispatch;\n");
+
+	for (int b = 0; b < blockCount; ++b) {
+		int start = blockStarts[b];
+		int end = blockEnds[b];
+		int length = (end - start) / 2;
+		fprintf(out, "\nblock_%03X:\n", start);
+		fprintf(out, "\tif (cpu->aotBlockModified[0x%03X - PROGRAM_START] || cpu->cycles + %d > cpu->cycleLimit || !cpu->running) goto interpret;\n", start, length);
+		enum opHandler last = OP_UNKNOWN;
+		int lastAddr = start;
+		for (int addr = start; addr < end; addr += 2) {
+			unsigned short op = opcode_at(addr);
+			last = cpu_decode_handler(op);
+			lastAddr = addr;
+			fprintf(out, "\tcpu->cycles++; PROFILED(op_%s)(cpu, INSTR(0x%04X));\n", opPatterns[last], op);
+		}
+		fprintf(out, "\t");
+		if (last == OP_1NNN || last == OP_2NNN) {
+			emit_goto(out, opcode_at(lastAddr) & 0x0FFF);
+		} else if (is_skip(last)) {
+			fprintf(out, "if (cpu->progCounter == 0x%03X) ", lastAddr + 4);
+			emit_goto(out, lastAddr + 4);
+			fprintf(out, "\t");
+			emit_goto(out, lastAddr + 2);
+		} else if (last == OP_00EE || last == OP_BNNN || last == OP_FX0A) {
+			fprintf(out, "goto dispatch;\n");
+		} else {
+			emit_goto(out, end);
+		}
+	}
+	fprintf(out, "}\n");
+	return blockCount;
+}
+
+int main(int argc, char *argv[]) {
+	int arg = 1;
+	if (argc == 5 && strcmp(argv[1], "--quirks") == 0) {
+		if (!quirks_find(argv[2], &profile)) {
+			printf("Unknown quirk profile %s\n", argv[2]);
+			return -1;
+		}
+		arg = 3;
+	}
+	if (argc - arg != 2) {
+		printf("Usage: %s [--quirks <legacy|vip|chip48|schip|modern>] <ROM> <output.c>\n", argv[0]);
+		return -1;
+	}
+	const char *romPath = argv[arg];
+	const char *outPath = argv[arg + 1];
+
+	FILE *romFile = fopen(romPath, "rb");
+	if (!romFile) {
+		printf("Couldn't open %s\n", romPath);
+		return -1;
+	}
+	romSize = (int)fread(memory + PROGRAM_START, 1, MEMORY_SIZE - PROGRAM_START, romFile);
+	fclose(romFile);
+	if (romSize <= 0 || romSize >= MEMORY_SIZE - PROGRAM_START) {
+		printf("ROM is empty or too big\n");
+		return -1;
+	}
+
+	cpu_build_decode_table();
+	analyse();
+
+	FILE *out = fopen(outPath, "w");
+	if (!out) {
+		printf("Couldn't write %s\n", outPath);
+		return -1;
+	}
+	const char *romName = strrchr(romPath, '/');
+	romName = romName ? romName + 1 : romPath;
+	int blocks = generate(out, romName);
+	fclose(out);
+
+	int codeBytes = 0;
+	for (int a = 0; a < MEMORY_SIZE; ++a) codeBytes += isCode[a] ? 2 : 0;
+	printf("%s: %d blocks, %d of %d bytes reachable as code\n", romName, blocks, codeBytes, romSize);
+	return 0;
+}
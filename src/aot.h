@@ -0,0 +1,32 @@
+//
+//  aot.h
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#ifndef aot_h
+#define aot_h
+
+#include "CPU.h"
+
+//Provided by a C file generated with chip8-aot, and linked into a per-game executable
+#ifdef CPU_AOT
+
+//The ROM the code was generated from
+extern const byte aotRom[];
+extern const long aotRomSize;
+extern const char *aotRomName;
+//The quirk profile the code was generated for, machines running it need to be set to it
+extern const enum quirkProfile aotQuirks;
+
+//Run until cpu->cycleLimit through the translated blocks
+void aot_run(chipCPU *cpu);
+
+//Memory in [addr, addr + length) was written, stop using blocks that no longer match the ROM
+void aot_invalidate(chipCPU *cpu, int addr, int length);
+
+#endif
+
+#endif /* aot_h */
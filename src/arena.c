@@ -0,0 +1,81 @@
+//
+//  arena.c
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "arena.h"
+
+#define CACHE_LINE 64
+
+struct arenaSlot {
+	chipCPU cpu; //First, so a chipCPU pointer is also a slot pointer
+	struct arenaSlot *nextFree;
+	bool inUse;
+	//Keep neighbouring CPUs off each other's cache lines when they run on different threads
+	char padding[CACHE_LINE];
+};
+
+struct arenaChunk {
+	struct arenaChunk *next;
+	int count;
+	struct arenaSlot slots[];
+};
+
+void cpu_arena_init(struct cpu_arena *arena, int chunkSize) {
+	arena->chunkSize = chunkSize > 0 ? chunkSize : 64;
+	arena->chunks = NULL;
+	arena->freeList = NULL;
+	arena->live = 0;
+}
+
+static bool add_chunk(struct cpu_arena *arena) {
+	struct arenaChunk *chunk = calloc(1, sizeof(*chunk) + arena->chunkSize * sizeof(struct arenaSlot));
+	if (!chunk) return false;
+	chunk->count = arena->chunkSize;
+	chunk->next = arena->chunks;
+	arena->chunks = chunk;
+	//Push in reverse so slots are handed out in address order
+	for (int i = chunk->count - 1; i >= 0; --i) {
+		chunk->slots[i].nextFree = arena->freeList;
+		arena->freeList = &chunk->slots[i];
+	}
+	return true;
+}
+
+chipCPU *cpu_arena_alloc(struct cpu_arena *arena) {
+	if (!arena->freeList && !add_chunk(arena)) {
+		return NULL;
+	}
+	struct arenaSlot *slot = arena->freeList;
+	arena->freeList = slot->nextFree;
+	slot->inUse = true;
+	arena->live++;
+	cpu_initialize(&slot->cpu);
+	return &slot->cpu;
+}
+
+void cpu_arena_free(struct cpu_arena *arena, chipCPU *cpu) {
+	if (!cpu) return;
+	struct arenaSlot *slot = (struct arenaSlot *)cpu;
+	cpu_destroy(cpu);
+	slot->inUse = false;
+	slot->nextFree = arena->freeList;
+	arena->freeList = slot;
+	arena->live--;
+}
+
+void cpu_arena_destroy(struct cpu_arena *arena) {
+	struct arenaChunk *chunk = arena->chunks;
+	while (chunk) {
+		struct arenaChunk *next = chunk->next;
+		for (int i = 0; i < chunk->count; ++i) {
+			if (chunk->slots[i].inUse) cpu_destroy(&chunk->slots[i].cpu);
+		}
+		free(chunk);
+		chunk = next;
+	}
+	cpu_arena_init(arena, arena->chunkSize);
+}
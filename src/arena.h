@@ -0,0 +1,38 @@
+//
+//  arena.h
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#ifndef arena_h
+#define arena_h
+
+#include "CPU.h"
+
+struct arenaChunk;
+struct arenaSlot;
+
+//Pool of CPU instances. Slots are carved out of big chunks instead of a malloc each,
+//so thousands of machines stay packed together, and freed slots are reused before a new chunk is allocated.
+//Not thread safe, guard it if several threads allocate or free.
+struct cpu_arena {
+	int chunkSize; //CPUs per chunk
+	struct arenaChunk *chunks;
+	struct arenaSlot *freeList;
+	size_t live;
+};
+
+void cpu_arena_init(struct cpu_arena *arena, int chunkSize);
+
+//Initialized CPU, or NULL if out of memory
+chipCPU *cpu_arena_alloc(struct cpu_arena *arena);
+
+//Destroy the CPU and give its slot back
+void cpu_arena_free(struct cpu_arena *arena, chipCPU *cpu);
+
+//Free every chunk. Any CPUs still allocated from the arena are destroyed too.
+void cpu_arena_destroy(struct cpu_arena *arena);
+
+#endif /* arena_h */
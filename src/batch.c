@@ -0,0 +1,231 @@
+//
+//  batch.c
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "batch.h"
+#include "thread.h"
+#include "timing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+//Job indices, the owner pushes and pops at the bottom, thieves take from the top.
+//Steals are rare next to a slice of frames, so a spinlock per deque is cheap enough.
+struct deque {
+	atomic_flag lock;
+	int *items;
+	int capacity;
+	int top;	//Index of the oldest item, wraps around
+	int count;
+};
+
+struct worker {
+	struct thread thread;
+	struct pool *pool;
+	struct deque deque;
+	unsigned long long slices;
+	unsigned long long steals;
+	unsigned int rng; //Picks who to steal from
+};
+
+struct pool {
+	struct batch_job *jobs;
+	int sliceFrames;
+	struct worker *workers;
+	int workerCount;
+	atomic_int remaining;
+};
+
+static void deque_lock(struct deque *d) {
+	while (atomic_flag_test_and_set_explicit(&d->lock, memory_order_acquire));
+}
+
+static void deque_unlock(struct deque *d) {
+	atomic_flag_clear_explicit(&d->lock, memory_order_release);
+}
+
+static void deque_push(struct deque *d, int item) {
+	deque_lock(d);
+	d->items[(d->top + d->count) % d->capacity] = item;
+	d->count++;
+	deque_unlock(d);
+}
+
+static bool deque_pop(struct deque *d, int *item) {
+	deque_lock(d);
+	bool got = d->count > 0;
+	if (got) {
+		d->count--;
+		*item = d->items[(d->top + d->count) % d->capacity];
+	}
+	deque_unlock(d);
+	return got;
+}
+
+static bool deque_steal(struct deque *d, int *item) {
+	deque_lock(d);
+	bool got = d->count > 0;
+	if (got) {
+		*item = d->items[d->top];
+		d->top = (d->top + 1) % d->capacity;
+		d->count--;
+	}
+	deque_unlock(d);
+	return got;
+}
+
+static bool steal(struct worker *self, int *item) {
+	struct pool *pool = self->pool;
+	//Start at a random victim so thieves don't all pile onto the same one
+	self->rng = self->rng * 1103515245 + 12345;
+	int start = (self->rng >> 16) % pool->workerCount;
+	for (int i = 0; i < pool->workerCount; ++i) {
+		struct worker *victim = &pool->workers[(start + i) % pool->workerCount];
+		if (victim == self) continue;
+		if (deque_steal(&victim->deque, item)) {
+			self->steals++;
+			return true;
+		}
+	}
+	return false;
+}
+
+//Run a slice of the job, returns true once it's finished
+static bool run_slice(struct batch_job *job, int sliceFrames) {
+	long end = job->framesRun + sliceFrames;
+	if (end > job->frames) end = job->frames;
+	while (job->framesRun < end) {
+		chip8_step_frame(job->machine);
+		job->framesRun++;
+		if (chip8_halted(job->machine)) {
+			job->state = batchJobHalted;
+			return true;
+		}
+	}
+	if (job->framesRun >= job->frames) {
+		job->state = batchJobDone;
+		return true;
+	}
+	if (chip8_waiting_for_key(job->machine)) {
+		job->state = batchJobStalled;
+		return true;
+	}
+	return false;
+}
+
+static void *worker_thread(void *arg) {
+	struct worker *self = (struct worker *)((struct thread *)arg)->userData;
+	struct pool *pool = self->pool;
+	while (atomic_load_explicit(&pool->remaining, memory_order_acquire) > 0) {
+		int item;
+		if (!deque_pop(&self->deque, &item) && !steal(self, &item)) {
+			//Everything left is being run by someone else
+			yieldThread();
+			continue;
+		}
+		self->slices++;
+		if (run_slice(&pool->jobs[item], pool->sliceFrames)) {
+			atomic_fetch_sub_explicit(&pool->remaining, 1, memory_order_release);
+		} else {
+			deque_push(&self->deque, item);
+		}
+	}
+	((struct thread *)arg)->threadComplete = true;
+	return NULL;
+}
+
+bool batch_run(struct batch_job *jobs, int count, int threads, int sliceFrames, struct batch_stats *stats) {
+	struct pool pool;
+	pool.jobs = jobs;
+	pool.sliceFrames = sliceFrames > 0 ? sliceFrames : 1;
+	pool.workerCount = threads > 0 ? threads : getSysCores();
+	atomic_init(&pool.remaining, count);
+	pool.workers = calloc(pool.workerCount, sizeof(struct worker));
+	if (!pool.workers) return false;
+	
+	unsigned long long cyclesBefore = 0;
+	for (int i = 0; i < count; ++i) {
+		jobs[i].framesRun = 0;
+		jobs[i].state = batchJobRunning;
+		cyclesBefore += chip8_cycles(jobs[i].machine);
+	}
+	
+	//Deal the jobs out round robin, stealing evens out the rest
+	for (int w = 0; w < pool.workerCount; ++w) {
+		struct worker *worker = &pool.workers[w];
+		worker->pool = &pool;
+		worker->rng = w + 1;
+		atomic_flag_clear(&worker->deque.lock);
+		worker->deque.capacity = count > 0 ? count : 1;
+		worker->deque.items = malloc(worker->deque.capacity * sizeof(int));
+		if (!worker->deque.items) {
+			//The workers were calloc'd, so the ones not reached yet free NULL
+			for (int i = 0; i <= w; ++i) free(pool.workers[i].deque.items);
+			free(pool.workers);
+			return false;
+		}
+		worker->thread.thread_num = w;
+		worker->thread.threadFunc = worker_thread;
+		worker->thread.userData = worker;
+	}
+	for (int i = 0; i < count; ++i) {
+		deque_push(&pool.workers[i % pool.workerCount].deque, i);
+	}
+	
+	long long start = time_now_ns();
+	int started = 0;
+	bool ok = true;
+	for (; started < pool.workerCount; ++started) {
+		if (startThread(&pool.workers[started].thread)) {
+			printf("Couldn't start batch worker %i\n", started);
+			ok = false;
+			//Let the ones already running finish the jobs
+			break;
+		}
+	}
+	if (started == 0) {
+		atomic_store(&pool.remaining, 0);
+	}
+	for (int w = 0; w < started; ++w) {
+		checkThread(&pool.workers[w].thread);
+	}
+	long long elapsed = time_now_ns() - start;
+	
+	if (stats) {
+		stats->threads = pool.workerCount;
+		stats->seconds = (double)elapsed / NSEC_PER_SEC;
+		stats->cycles = 0;
+		stats->slices = 0;
+		stats->steals = 0;
+		stats->done = stats->halted = stats->stalled = 0;
+		for (int i = 0; i < count; ++i) {
+			stats->cycles += chip8_cycles(jobs[i].machine);
+			stats->done += jobs[i].state == batchJobDone;
+			stats->halted += jobs[i].state == batchJobHalted;
+			stats->stalled += jobs[i].state == batchJobStalled;
+		}
+		stats->cycles -= cyclesBefore;
+		for (int w = 0; w < pool.workerCount; ++w) {
+			stats->slices += pool.workers[w].slices;
+			stats->steals += pool.workers[w].steals;
+		}
+	}
+	for (int w = 0; w < pool.workerCount; ++w) {
+		free(pool.workers[w].deque.items);
+	}
+	free(pool.workers);
+	return ok && started > 0;
+}
+
+void batch_print_stats(const struct batch_stats *stats) {
+	printf("%i threads: %i done, %i halted, %i stalled on input, %llu cycles in %.3fs",
+		   stats->threads, stats->done, stats->halted, stats->stalled, stats->cycles, stats->seconds);
+	if (stats->seconds > 0) {
+		printf(" (%.0f instructions/sec)", stats->cycles / stats->seconds);
+	}
+	printf(", %llu slices, %llu steals\n", stats->slices, stats->steals);
+}
@@ -0,0 +1,51 @@
+//
+//  batch.h
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#ifndef batch_h
+#define batch_h
+
+#include <stdbool.h>
+#include "chip8.h"
+
+//Batch executor, runs many machines to completion across a work-stealing thread pool.
+//Each worker owns a deque of jobs, runs a slice of frames from the job at the bottom and pushes
+//it back if it isn't done. Workers that run out steal from the top of someone else's deque,
+//so machines that halt or stall early just leave more work for everyone else to spread out.
+
+enum batchJobState {
+	batchJobRunning,
+	batchJobDone,	 //Ran all its frames
+	batchJobHalted,	 //CPU stopped
+	batchJobStalled, //Waiting on FX0A with no key pressed, it would never get further
+};
+
+struct batch_job {
+	struct chip8 *machine;
+	long frames; //Frames to run
+	
+	//Filled in by the executor
+	long framesRun;
+	enum batchJobState state;
+};
+
+struct batch_stats {
+	int threads;
+	double seconds;
+	unsigned long long cycles;
+	unsigned long long slices;
+	unsigned long long steals;
+	int done, halted, stalled;
+};
+
+//Run every job with the given number of threads (0 for one per core), sliceFrames frames at a time.
+//Returns false if the workers couldn't be started.
+bool batch_run(struct batch_job *jobs, int count, int threads, int sliceFrames, struct batch_stats *stats);
+
+void batch_print_stats(const struct batch_stats *stats);
+
+#endif /* batch_h */
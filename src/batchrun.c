@@ -0,0 +1,311 @@
+//
+//  batchrun.c
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+//chip8-batch, runs many headless machines at once on the batch executor.
+//With --scaling it repeats the run with 1, 2, 4... up to N threads and reports how well it scales.
+//With --lockstep the instances run in groups on the lockstep interpreter instead, on one thread.
+//With --state every instance starts from the same save state instead of a ROM.
+//Instances share the random seed, and each draws from its own stream, the instance number.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chip8.h"
+#include "batch.h"
+#include "thread.h"
+#include "lockstep.h"
+#include "rng.h"
+#include "timing.h"
+
+#define MAX_ROMS 64
+
+struct rom {
+	unsigned char data[CHIP8_MAX_ROM_SIZE];
+	long size;
+};
+
+//A save state read into memory once, then loaded into every instance
+struct state {
+	unsigned char *data;
+	size_t size;
+};
+
+static void print_usage(char *name) {
+	printf("Usage: %s [--instances <n>] [--frames <n>] [--threads <n>] [--slice <frames>] [--ipf <n>] [--keys <hex mask>] [--vary-keys] [--jit] [--quirks <profile>] [--seed <n>] [--scaling] [--lockstep <lanes>] [--verify] [--state <file>] <ROM> [ROM...]\n", name);
+}
+
+//With --vary-keys, instance i holds down key i % 17, or nothing for 16
+static uint16_t instance_keys(int instance, uint16_t keys, bool varyKeys) {
+	if (!varyKeys) return keys;
+	int key = instance % 17;
+	return key < 16 ? 1 << key : 0;
+}
+
+static unsigned long long hash_display(const uint64_t *rows) {
+	unsigned long long hash = 0xcbf29ce484222325ULL;
+	for (int r = 0; r < CHIP8_DISPLAY_HEIGHT; ++r) {
+		hash ^= rows[r];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+//Set up the machines fresh, instances are dealt round robin over the ROMs, or all start from the state if there is one
+static bool create_jobs(struct batch_job *jobs, int count, struct rom *roms, int romCount, struct state *state, long frames, int cyclesPerFrame, uint16_t keys, bool varyKeys, bool jit, enum quirkProfile quirks, uint64_t seed) {
+	for (int i = 0; i < count; ++i) {
+		jobs[i].machine = chip8_create(cyclesPerFrame);
+		if (!jobs[i].machine) return false;
+		chip8_set_quiet(jobs[i].machine, true);
+		if (state->data) {
+			if (chip8_load_state(jobs[i].machine, state->data, state->size) != 0) return false;
+		} else {
+			chip8_set_seed(jobs[i].machine, seed, i);
+			chip8_set_quirks(jobs[i].machine, quirks);
+			if (chip8_load_rom(jobs[i].machine, roms[i % romCount].data, roms[i % romCount].size) != 0) return false;
+		}
+		chip8_set_keys(jobs[i].machine, instance_keys(i, keys, varyKeys));
+		chip8_set_jit(jobs[i].machine, jit);
+		jobs[i].frames = frames;
+	}
+	return true;
+}
+
+static void destroy_jobs(struct batch_job *jobs, int count) {
+	for (int i = 0; i < count; ++i) {
+		chip8_destroy(jobs[i].machine);
+		jobs[i].machine = NULL;
+	}
+}
+
+//Run every instance of the first ROM on lockstep groups of the given width.
+//With verify, every lane is checked against a separate machine run through chip8_step_frame().
+static int run_lockstep(struct rom *rom, int instances, int lanes, long frames, int cyclesPerFrame, uint16_t keys, bool varyKeys, enum quirkProfile quirks, uint64_t seed, bool verify) {
+	int groupCount = (instances + lanes - 1) / lanes;
+	struct lockstep **groups = calloc(groupCount, sizeof(*groups));
+	if (!groups) return -1;
+	for (int g = 0; g < groupCount; ++g) {
+		int width = g == groupCount - 1 ? instances - g * lanes : lanes;
+		groups[g] = lockstep_create(width, cyclesPerFrame);
+		if (!groups[g]) {
+			printf("Couldn't create lockstep group %i\n", g);
+			return -1;
+		}
+		lockstep_set_quirks(groups[g], quirks);
+		if (lockstep_load_rom(groups[g], rom->data, rom->size) != 0) {
+			printf("Couldn't load the ROM into lockstep group %i\n", g);
+			return -1;
+		}
+		for (int l = 0; l < width; ++l) {
+			lockstep_set_keys(groups[g], l, instance_keys(g * lanes + l, keys, varyKeys));
+			lockstep_set_seed(groups[g], l, seed, g * lanes + l);
+		}
+	}
+	
+	long long start = time_now_ns();
+	for (int g = 0; g < groupCount; ++g) {
+		for (long f = 0; f < frames; ++f) {
+			lockstep_run_frame(groups[g]);
+		}
+	}
+	double seconds = (double)(time_now_ns() - start) / NSEC_PER_SEC;
+	
+	unsigned long long cycles = 0;
+	unsigned long long steps = 0;
+	unsigned long long scalarSteps = 0;
+	double laneSum = 0;
+	int halted = 0;
+	int mismatches = 0;
+	for (int g = 0; g < groupCount; ++g) {
+		int width = g == groupCount - 1 ? instances - g * lanes : lanes;
+		unsigned long long groupSteps, groupScalar;
+		double lanesPerStep;
+		lockstep_stats(groups[g], &groupSteps, &lanesPerStep, &groupScalar);
+		steps += groupSteps;
+		scalarSteps += groupScalar;
+		laneSum += lanesPerStep * groupSteps;
+		for (int l = 0; l < width; ++l) {
+			cycles += lockstep_cycles(groups[g], l);
+			halted += lockstep_halted(groups[g], l);
+			if (!verify) continue;
+			struct chip8 *machine = chip8_create(cyclesPerFrame);
+			if (!machine) {
+				printf("Couldn't create a machine to verify against\n");
+				return -1;
+			}
+			chip8_set_quiet(machine, true);
+			chip8_set_seed(machine, seed, g * lanes + l);
+			chip8_set_quirks(machine, quirks);
+			if (chip8_load_rom(machine, rom->data, rom->size) != 0) {
+				printf("Couldn't load the ROM to verify against\n");
+				return -1;
+			}
+			chip8_set_keys(machine, instance_keys(g * lanes + l, keys, varyKeys));
+			for (long f = 0; f < frames && !chip8_halted(machine); ++f) {
+				chip8_step_frame(machine);
+			}
+			uint64_t expected[CHIP8_DISPLAY_HEIGHT], got[CHIP8_DISPLAY_HEIGHT];
+			chip8_read_framebuffer(machine, expected);
+			lockstep_read_framebuffer(groups[g], l, got);
+			if (hash_display(expected) != hash_display(got) || chip8_cycles(machine) != lockstep_cycles(groups[g], l)) {
+				mismatches++;
+			}
+			chip8_destroy(machine);
+		}
+		lockstep_destroy(groups[g]);
+	}
+	free(groups);
+	
+	printf("Lockstep, %i lanes: %i halted, %llu cycles in %.3fs", lanes, halted, cycles, seconds);
+	if (seconds > 0) {
+		printf(" (%.0f instructions/sec)", cycles / seconds);
+	}
+	printf(", %.1f lanes per step, %llu of %llu steps lane by lane\n", steps ? laneSum / steps : 0, scalarSteps, steps);
+	if (verify) {
+		printf("Verify: %i of %i lanes differ from separate machines\n", mismatches, instances);
+	}
+	return mismatches ? -1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+	int instances = 1000;
+	long frames = 600;
+	int threads = 0;
+	int sliceFrames = 60;
+	int cyclesPerFrame = 0;
+	uint16_t keys = 0;
+	bool varyKeys = false;
+	bool jit = false;
+	enum quirkProfile quirks = quirksLegacy;
+	uint64_t seed = RNG_DEFAULT_SEED;
+	bool scaling = false;
+	int lanes = 0;
+	bool verify = false;
+	static struct rom roms[MAX_ROMS];
+	int romCount = 0;
+	struct state state = {0};
+	
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+			instances = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+			frames = atol(argv[++i]);
+		} else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			threads = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--slice") == 0 && i + 1 < argc) {
+			sliceFrames = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--ipf") == 0 && i + 1 < argc) {
+			cyclesPerFrame = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--keys") == 0 && i + 1 < argc) {
+			keys = (uint16_t)strtoul(argv[++i], NULL, 16);
+		} else if (strcmp(argv[i], "--vary-keys") == 0) {
+			varyKeys = true;
+		} else if (strcmp(argv[i], "--lockstep") == 0 && i + 1 < argc) {
+			lanes = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--verify") == 0) {
+			verify = true;
+		} else if (strcmp(argv[i], "--jit") == 0) {
+			jit = true;
+		} else if (strcmp(argv[i], "--quirks") == 0 && i + 1 < argc) {
+			if (!quirks_find(argv[++i], &quirks)) {
+				printf("Unknown quirk profile %s, use legacy, vip, chip48, schip or modern\n", argv[i]);
+				return -1;
+			}
+		} else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			seed = strtoull(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "--state") == 0 && i + 1 < argc) {
+			FILE *file = fopen(argv[++i], "rb");
+			if (!file) {
+				printf("Couldn't open %s\n", argv[i]);
+				return -1;
+			}
+			state.size = chip8_state_size();
+			state.data = malloc(state.size);
+			if (!state.data || fread(state.data, 1, state.size, file) != state.size) {
+				printf("%s is too short to be a save state\n", argv[i]);
+				return -1;
+			}
+			fclose(file);
+		} else if (strcmp(argv[i], "--scaling") == 0) {
+			scaling = true;
+		} else if (argv[i][0] != '-' && romCount < MAX_ROMS) {
+			switch (chip8_read_rom_file(argv[i], roms[romCount].data, &roms[romCount].size)) {
+				case 0:
+					break;
+				case -2:
+					printf("%s is too big to be a ROM\n", argv[i]);
+					return -1;
+				default:
+					printf("Couldn't open %s\n", argv[i]);
+					return -1;
+			}
+			romCount++;
+		} else {
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+	if ((!romCount && !state.data) || instances < 1 || frames < 1) {
+		print_usage(argv[0]);
+		return -1;
+	}
+	if (threads < 1) threads = getSysCores();
+	
+	if (lanes > 0) {
+		if (state.data) {
+			printf("Lockstep groups can't start from a save state\n");
+			return -1;
+		}
+		if (romCount > 1) printf("Lockstep runs a single ROM, only using the first one\n");
+		printf("%i instances, %ld frames each\n", instances, frames);
+		return run_lockstep(&roms[0], instances, lanes, frames, cyclesPerFrame, keys, varyKeys, quirks, seed, verify);
+	}
+	
+	struct batch_job *jobs = calloc(instances, sizeof(*jobs));
+	if (!jobs) {
+		printf("Out of memory\n");
+		return -1;
+	}
+	if (state.data) {
+		printf("%i instances from a save state, %ld frames each\n", instances, frames);
+	} else {
+		printf("%i instances of %i ROM(s), %ld frames each\n", instances, romCount, frames);
+	}
+	
+	//Thread counts to try, doubling up to the maximum
+	int counts[32];
+	int runs = 0;
+	if (scaling) {
+		for (int t = 1; t < threads && runs < 31; t *= 2) counts[runs++] = t;
+	}
+	counts[runs++] = threads;
+	
+	double baseRate = 0;
+	for (int r = 0; r < runs; ++r) {
+		if (!create_jobs(jobs, instances, roms, romCount, &state, frames, cyclesPerFrame, keys, varyKeys, jit, quirks, seed)) {
+			printf("Couldn't create %i machines%s\n", instances, state.data ? " from the save state" : "");
+			return -1;
+		}
+		struct batch_stats stats;
+		if (!batch_run(jobs, instances, counts[r], sliceFrames, &stats)) {
+			printf("Batch run failed\n");
+			return -1;
+		}
+		batch_print_stats(&stats);
+		double rate = stats.seconds > 0 ? stats.cycles / stats.seconds : 0;
+		if (r == 0) baseRate = rate;
+		if (scaling && baseRate > 0) {
+			double speedup = rate / baseRate;
+			printf("  speedup %.2fx over 1 thread, %.0f%% efficiency\n", speedup, 100.0 * speedup / counts[r] * counts[0]);
+		}
+		destroy_jobs(jobs, instances);
+	}
+	
+	free(jobs);
+	free(state.data);
+	return 0;
+}
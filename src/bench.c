@@ -0,0 +1,336 @@
+//
+//  bench.c
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+//chip8-bench, measures the emulator core and prints the results as JSON on stdout.
+//Every ROM given is run flat out for a fixed number of instructions, then a set of built in
+//microbenchmark ROMs times one instruction class each. Progress goes to stderr.
+//Runs are deterministic, so every build runs exactly the same instructions and the numbers compare.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chip8.h"
+#include "timing.h"
+
+//ROMs that spend almost all their time in fast-forwarded idle loops stop after this many times
+//the instruction budget of cycles, run or skipped
+#define MAX_IDLE_RATIO 1000
+
+//Microbenchmarks run this many instructions per frame, so the frame loop doesn't show up in them
+#define MICRO_IPF 100000
+
+//Copies of the instruction under test in each loop iteration
+#define BODY_LENGTH 64
+
+//Stand-ins in a microbenchmark body, filled in once the ROM is laid out
+#define JUMP_NEXT 0x1000 //Jump to the next instruction
+#define CALL_RETURN 0x2000 //Call a subroutine that only returns
+
+//A loop of BODY_LENGTH copies of one instruction. Every iteration starts with ANNN to put I back,
+//and ends with 7E01 and a jump back. VE counting up keeps the loop from looking idle.
+struct microbench {
+	const char *name;
+	const char *description;
+	uint16_t setup[2]; //Run once before the loop, 0 ends it
+	uint16_t instruction; //0 for none, which times the loop on its own
+	uint16_t I;
+	int executes; //Instructions one copy runs
+};
+
+static const struct microbench microbenches[] = {
+	{ "loop", "ANNN, 7XNN and 1NNN of every iteration, taken off the others", {0}, 0, 0x000, 0 },
+	{ "00E0", "Clear the display", {0}, 0x00E0, 0x000, 1 },
+	{ "1NNN", "Jump to the next instruction", {0}, JUMP_NEXT, 0x000, 1 },
+	{ "2NNN", "Call a subroutine and return from it with 00EE", {0}, CALL_RETURN, 0x000, 2 },
+	{ "3XNN", "Skip, not taken", {0}, 0x35FF, 0x000, 1 },
+	{ "6XNN", "Set a register", {0}, 0x6042, 0x000, 1 },
+	{ "7XNN", "Add to a register", {0}, 0x7001, 0x000, 1 },
+	{ "8XY2", "AND two registers", {0x6107}, 0x8012, 0x000, 1 },
+	{ "8XY4", "Add two registers with carry", {0x6103}, 0x8014, 0x000, 1 },
+	{ "8XY5", "Subtract two registers with borrow", {0x6103}, 0x8015, 0x000, 1 },
+	{ "8XYE", "Shift left", {0x6081}, 0x801E, 0x000, 1 },
+	{ "ANNN", "Set I", {0}, 0xA123, 0x000, 1 },
+	{ "CXNN", "Random number", {0}, 0xC0FF, 0x000, 1 },
+	{ "DXYN", "Draw a 5 row font sprite", {0}, 0xD015, 0x000, 1 },
+	{ "EX9E", "Skip if a key is pressed, not taken", {0}, 0xE09E, 0x000, 1 },
+	{ "FX07", "Read the delay timer", {0}, 0xF007, 0x000, 1 },
+	{ "FX15", "Set the delay timer", {0}, 0xF015, 0x000, 1 },
+	{ "FX1E", "Add to I", {0x6101}, 0xF11E, 0x000, 1 },
+	{ "FX29", "Point I at a font sprite", {0}, 0xF029, 0x000, 1 },
+	{ "FX33", "Store BCD", {0}, 0xF033, 0xE00, 1 },
+	{ "FX55", "Store V0-V3", {0}, 0xF355, 0xE00, 1 },
+	{ "FX65", "Load V0-V3", {0}, 0xF365, 0xE00, 1 },
+};
+
+#define MICROBENCH_COUNT (sizeof(microbenches) / sizeof(microbenches[0]))
+
+struct options {
+	unsigned long long instructions;
+	int repeat;
+	int cyclesPerFrame;
+	bool jit;
+	enum quirkProfile quirks;
+	bool keysGiven;
+	uint16_t keys;
+};
+
+//Fastest of the repeats
+struct result {
+	unsigned long long cycles;
+	unsigned long long idleCycles;
+	double seconds;
+	unsigned long long displayHash;
+	bool halted;
+};
+
+static void print_usage(char *name) {
+	printf("Usage: %s [--instructions <n>] [--repeat <n>] [--ipf <n>] [--jit] [--quirks <profile>] [--keys <hex mask>] [--no-micro] [ROM...]\n", name);
+	printf("Without --keys, ROMs are given a different key every 30 frames, so ones waiting for input get going.\n");
+}
+
+static unsigned long long hash_display(const uint64_t *rows) {
+	unsigned long long hash = 0xcbf29ce484222325ULL;
+	for (int r = 0; r < CHIP8_DISPLAY_HEIGHT; ++r) {
+		for (int b = 0; b < 8; ++b) {
+			hash ^= (rows[r] >> (b * 8)) & 0xFF;
+			hash *= 0x100000001b3ULL;
+		}
+	}
+	return hash;
+}
+
+static void put_instruction(unsigned char *rom, long *size, uint16_t instruction) {
+	rom[(*size)++] = instruction >> 8;
+	rom[(*size)++] = instruction & 0xFF;
+}
+
+//Lay the loop out at 0x200, with the subroutine for CALL_RETURN after it
+static long build_microbench(const struct microbench *m, unsigned char *rom) {
+	long size = 0;
+	for (int i = 0; i < 2 && m->setup[i]; ++i) put_instruction(rom, &size, m->setup[i]);
+	uint16_t loop = 0x200 + size;
+	uint16_t subroutine = loop + (BODY_LENGTH + 3) * 2;
+	put_instruction(rom, &size, 0xA000 | m->I);
+	for (int i = 0; i < BODY_LENGTH && m->instruction; ++i) {
+		uint16_t instruction = m->instruction;
+		if (instruction == JUMP_NEXT) instruction = 0x1000 | (0x200 + size + 2);
+		if (instruction == CALL_RETURN) instruction = 0x2000 | subroutine;
+		put_instruction(rom, &size, instruction);
+	}
+	put_instruction(rom, &size, 0x7E01);
+	put_instruction(rom, &size, 0x1000 | loop);
+	put_instruction(rom, &size, 0x00EE);
+	return size;
+}
+
+//Run a fresh machine until it's run the instructions, repeat times, and keep the fastest.
+//Fast-forwarded idle loops don't count towards them, the time taken skipping them does.
+static bool run(const unsigned char *rom, long size, const struct options *o, int cyclesPerFrame, bool varyKeys, struct result *best) {
+	for (int r = 0; r < o->repeat; ++r) {
+		struct chip8 *machine = chip8_create(cyclesPerFrame);
+		if (!machine) return false;
+		chip8_set_quiet(machine, true);
+		chip8_set_quirks(machine, o->quirks);
+		if (chip8_load_rom(machine, rom, size) != 0) {
+			chip8_destroy(machine);
+			return false;
+		}
+		chip8_set_jit(machine, o->jit);
+		chip8_set_keys(machine, o->keys);
+	
+		long long start = time_now_ns();
+		for (unsigned long frame = 0; !chip8_halted(machine); ++frame) {
+			unsigned long long cycles = chip8_cycles(machine);
+			if (cycles - chip8_idle_cycles(machine) >= o->instructions || cycles >= o->instructions * MAX_IDLE_RATIO) break;
+			if (varyKeys) chip8_set_keys(machine, 1 << (frame / 30 % 16));
+			chip8_step_frame(machine);
+		}
+		double seconds = (double)(time_now_ns() - start) / NSEC_PER_SEC;
+	
+		if (r == 0 || seconds < best->seconds) {
+			uint64_t rows[CHIP8_DISPLAY_HEIGHT];
+			chip8_read_framebuffer(machine, rows);
+			best->cycles = chip8_cycles(machine);
+			best->idleCycles = chip8_idle_cycles(machine);
+			best->seconds = seconds;
+			best->displayHash = hash_display(rows);
+			best->halted = chip8_halted(machine);
+		}
+		chip8_destroy(machine);
+	}
+	return true;
+}
+
+static unsigned long long executed(const struct result *r) {
+	return r->cycles - r->idleCycles;
+}
+
+static double mips(const struct result *r) {
+	return r->seconds > 0 ? executed(r) / r->seconds / 1e6 : 0;
+}
+
+static double ns_per_instruction(const struct result *r) {
+	return executed(r) ? r->seconds * 1e9 / executed(r) : 0;
+}
+
+//ROM names come from file names, which can have anything in them
+static void print_json_string(const char *s) {
+	putchar('"');
+	for (; *s; ++s) {
+		if (*s == '"' || *s == '\\') {
+			printf("\\%c", *s);
+		} else if ((unsigned char)*s < 0x20) {
+			printf("\\u%04x", *s);
+		} else {
+			putchar(*s);
+		}
+	}
+	putchar('"');
+}
+
+static const char *base_name(const char *path) {
+	const char *name = path;
+	for (const char *p = path; *p; ++p) {
+		if (*p == '/' || *p == '\\') name = p + 1;
+	}
+	return name;
+}
+
+static const char *dispatch_name(void) {
+#if defined(CPU_DISPATCH_THREADED)
+	return "threaded";
+#elif defined(CPU_DISPATCH_TABLE)
+	return "table";
+#else
+	return "switch";
+#endif
+}
+
+int main(int argc, char *argv[]) {
+	struct options o = {
+		.instructions = 10000000,
+		.repeat = 3,
+		.cyclesPerFrame = 1000,
+		.quirks = quirksLegacy,
+	};
+	bool micro = true;
+	char **roms = calloc(argc, sizeof(*roms));
+	int romCount = 0;
+	if (!roms) return -1;
+	
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--instructions") == 0 && i + 1 < argc) {
+			o.instructions = strtoull(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+			o.repeat = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--ipf") == 0 && i + 1 < argc) {
+			o.cyclesPerFrame = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--jit") == 0) {
+			o.jit = true;
+		} else if (strcmp(argv[i], "--quirks") == 0 && i + 1 < argc) {
+			if (!quirks_find(argv[++i], &o.quirks)) {
+				printf("Unknown quirk profile %s, use legacy, vip, chip48, schip or modern\n", argv[i]);
+				return -1;
+			}
+		} else if (strcmp(argv[i], "--keys") == 0 && i + 1 < argc) {
+			o.keys = (uint16_t)strtoul(argv[++i], NULL, 16);
+			o.keysGiven = true;
+		} else if (strcmp(argv[i], "--no-micro") == 0) {
+			micro = false;
+		} else if (argv[i][0] != '-') {
+			roms[romCount++] = argv[i];
+		} else {
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+	if (o.instructions < 1 || o.repeat < 1 || o.cyclesPerFrame < 1 || (!romCount && !micro)) {
+		print_usage(argv[0]);
+		return -1;
+	}
+	//Check for the JIT once up front, so the report says what actually ran
+	if (o.jit) {
+		struct chip8 *probe = chip8_create(0);
+		if (!probe) return -1;
+		o.jit = chip8_set_jit(probe, true);
+		chip8_destroy(probe);
+		if (!o.jit) fprintf(stderr, "JIT recompiler not built in, using the interpreter\n");
+	}
+	
+	printf("{\n");
+	printf("\t\"dispatch\": \"%s\",\n", dispatch_name());
+	printf("\t\"jit\": %s,\n", o.jit ? "true" : "false");
+	printf("\t\"quirks\": \"%s\",\n", quirkProfiles[o.quirks].name);
+	printf("\t\"instructions\": %llu,\n", o.instructions);
+	printf("\t\"repeat\": %i,\n", o.repeat);
+	printf("\t\"ipf\": %i,\n", o.cyclesPerFrame);
+	
+	//ROMs, counting only the instructions actually run. Cycles of idle loops that got fast-forwarded are reported separately.
+	int failed = 0;
+	int reported = 0;
+	unsigned long long totalExecuted = 0;
+	double totalSeconds = 0;
+	printf("\t\"roms\": [");
+	for (int i = 0; i < romCount; ++i) {
+		static unsigned char rom[CHIP8_MAX_ROM_SIZE];
+		long size = 0;
+		struct result r;
+		if (chip8_read_rom_file(roms[i], rom, &size) != 0 || !run(rom, size, &o, o.cyclesPerFrame, !o.keysGiven, &r)) {
+			fprintf(stderr, "Couldn't run %s\n", roms[i]);
+			failed++;
+			continue;
+		}
+		fprintf(stderr, "%-10s %8.1f MIPS %6.2f ns/instruction %5.1f%% idle\n", base_name(roms[i]), mips(&r), ns_per_instruction(&r),
+				r.cycles ? 100.0 * r.idleCycles / r.cycles : 0);
+		totalExecuted += executed(&r);
+		totalSeconds += r.seconds;
+		printf("%s\n\t\t{\"name\": ", reported++ ? "," : "");
+		print_json_string(base_name(roms[i]));
+		printf(", \"cycles\": %llu, \"executed\": %llu, \"idle\": %llu, \"seconds\": %.6f, \"mips\": %.2f, \"ns_per_instruction\": %.3f, \"halted\": %s, \"display_hash\": \"%016llx\"}",
+			   r.cycles, executed(&r), r.idleCycles, r.seconds, mips(&r), ns_per_instruction(&r), r.halted ? "true" : "false", r.displayHash);
+	}
+	printf("%s],\n", reported ? "\n\t" : "");
+	printf("\t\"total\": {\"executed\": %llu, \"seconds\": %.6f, \"mips\": %.2f},\n", totalExecuted, totalSeconds,
+		   totalSeconds > 0 ? totalExecuted / totalSeconds / 1e6 : 0);
+	
+	//Microbenchmarks. An instruction's latency is its loop's time per iteration less the bare loop's, over the copies in it.
+	printf("\t\"opcodes\": [");
+	reported = 0;
+	double loopNs = 0;
+	for (size_t i = 0; micro && i < MICROBENCH_COUNT; ++i) {
+		const struct microbench *m = &microbenches[i];
+		unsigned char rom[CHIP8_MAX_ROM_SIZE];
+		long size = build_microbench(m, rom);
+		struct result r;
+		//Keys stay up, so EX9E is never taken
+		struct options microOptions = o;
+		microOptions.keys = 0;
+		if (!run(rom, size, &microOptions, MICRO_IPF, false, &r)) {
+			fprintf(stderr, "Couldn't run the %s microbenchmark\n", m->name);
+			failed++;
+			continue;
+		}
+		int perIteration = 3 + BODY_LENGTH * m->executes;
+		double iterationNs = r.seconds * 1e9 / ((double)executed(&r) / perIteration);
+		double latency = 0;
+		if (m->executes) {
+			latency = (iterationNs - loopNs) / (BODY_LENGTH * m->executes);
+			if (latency < 0) latency = 0;
+		} else {
+			loopNs = iterationNs;
+		}
+		fprintf(stderr, "%-10s %8.1f MIPS %6.2f ns/instruction\n", m->name, mips(&r), m->executes ? latency : ns_per_instruction(&r));
+		printf("%s\n\t\t{\"name\": \"%s\", \"description\": \"%s\", \"executed\": %llu, \"idle\": %llu, \"seconds\": %.6f, \"mips\": %.2f, \"ns_per_instruction\": %.3f}",
+			   reported++ ? "," : "", m->name, m->description, executed(&r), r.idleCycles, r.seconds, mips(&r), m->executes ? latency : ns_per_instruction(&r));
+	}
+	printf("%s]\n", reported ? "\n\t" : "");
+	printf("}\n");
+	
+	free(roms);
+	return failed ? -1 : 0;
+}
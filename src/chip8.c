@@ -0,0 +1,229 @@
+//
+//  chip8.c
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#include <stdatomic.h>
+#include "chip8.h"
+#include "CPU.h"
+#include "arena.h"
+#include "savestate.h"
+#include "trace.h"
+#include "profile.h"
+
+struct chip8 {
+	chipCPU *cpu;
+	int cyclesPerFrame;
+	uint64_t seed;
+	uint64_t stream;
+};
+
+//Every machine's CPU comes from one arena. Creating and destroying machines is rare next to
+//running them, so a spinlock around it is plenty.
+static struct cpu_arena arena;
+static bool arenaReady = false;
+static atomic_flag arenaLock = ATOMIC_FLAG_INIT;
+
+static void arena_lock() {
+	while (atomic_flag_test_and_set_explicit(&arenaLock, memory_order_acquire));
+}
+
+static void arena_unlock() {
+	atomic_flag_clear_explicit(&arenaLock, memory_order_release);
+}
+
+struct chip8 *chip8_create(int cyclesPerFrame) {
+	struct chip8 *c = malloc(sizeof(*c));
+	if (!c) return NULL;
+	arena_lock();
+	if (!arenaReady) {
+		cpu_arena_init(&arena, 0);
+		arenaReady = true;
+	}
+	c->cpu = cpu_arena_alloc(&arena);
+	arena_unlock();
+	if (!c->cpu) {
+		free(c);
+		return NULL;
+	}
+	c->cyclesPerFrame = cyclesPerFrame > 0 ? cyclesPerFrame : cyclesPerFrameNormal;
+	c->seed = RNG_DEFAULT_SEED;
+	c->stream = 0;
+	cpu_set_timer_mode(c->cpu, timerModeCycles, c->cyclesPerFrame);
+	return c;
+}
+
+int chip8_load_rom(struct chip8 *c, const unsigned char *rom, long size) {
+	return cpu_load_rom_buffer(c->cpu, rom, size);
+}
+
+int chip8_read_rom_file(const char *path, unsigned char *buffer, long *size) {
+	FILE *file = fopen(path, "rb");
+	if (!file) return -1;
+	*size = (long)fread(buffer, 1, CHIP8_MAX_ROM_SIZE, file);
+	//One byte more than fits means the ROM is too big
+	bool tooBig = *size == CHIP8_MAX_ROM_SIZE || fgetc(file) != EOF;
+	//A directory opens fine on some systems and only fails to read, and an empty file isn't a ROM either
+	bool unreadable = ferror(file) || *size == 0;
+	fclose(file);
+	if (unreadable) return -1;
+	return tooBig ? -2 : 0;
+}
+
+int chip8_load_rom_file(struct chip8 *c, const char *path) {
+	unsigned char buffer[CHIP8_MAX_ROM_SIZE];
+	long size = 0;
+	int result = chip8_read_rom_file(path, buffer, &size);
+	if (result != 0) return result;
+	return chip8_load_rom(c, buffer, size);
+}
+
+size_t chip8_state_size(void) {
+	return SAVESTATE_SIZE;
+}
+
+size_t chip8_save_state(struct chip8 *c, unsigned char *buffer) {
+	return savestate_write(c->cpu, buffer);
+}
+
+//Frames are as long as the timer ticks the state was saved with
+static int state_loaded(struct chip8 *c, int result) {
+	if (result == 0) c->cyclesPerFrame = c->cpu->cyclesPerTick;
+	return result;
+}
+
+int chip8_load_state(struct chip8 *c, const unsigned char *state, size_t size) {
+	return state_loaded(c, savestate_read(c->cpu, state, size));
+}
+
+int chip8_save_state_file(struct chip8 *c, const char *path) {
+	return savestate_save_file(c->cpu, path);
+}
+
+int chip8_load_state_file(struct chip8 *c, const char *path) {
+	return state_loaded(c, savestate_load_file(c->cpu, path));
+}
+
+void chip8_set_seed(struct chip8 *c, uint64_t seed, uint64_t stream) {
+	c->seed = seed;
+	c->stream = stream;
+	cpu_set_seed(c->cpu, seed, stream);
+}
+
+uint64_t chip8_seed(const struct chip8 *c) {
+	return c->seed;
+}
+
+uint64_t chip8_stream(const struct chip8 *c) {
+	return c->stream;
+}
+
+int chip8_cycles_per_frame(const struct chip8 *c) {
+	return c->cyclesPerFrame;
+}
+
+void chip8_set_quirks(struct chip8 *c, enum quirkProfile profile) {
+	cpu_set_quirks(c->cpu, profile);
+}
+
+int chip8_step(struct chip8 *c, int cycles) {
+	return cpu_run(c->cpu, cycles);
+}
+
+int chip8_step_frame(struct chip8 *c) {
+	int executed = cpu_run(c->cpu, c->cyclesPerFrame);
+	if (!cpu_has_halted(c->cpu)) {
+		cpu_update_timers(c->cpu);
+	}
+	PROFILE_FRAME(c->cpu);
+	return executed;
+}
+
+bool chip8_halted(const struct chip8 *c) {
+	return cpu_has_halted(c->cpu);
+}
+
+bool chip8_waiting_for_key(const struct chip8 *c) {
+	chipCPU *cpu = c->cpu;
+	if (cpu->progCounter >= MEMORY_SIZE - 1) return false;
+	unsigned short op = cpu->memory[cpu->progCounter] << 8 | cpu->memory[cpu->progCounter + 1];
+	return (op & 0xF0FF) == 0xF00A && !cpu->keys;
+}
+
+void chip8_set_keys(struct chip8 *c, uint16_t keys) {
+	cpu_set_keys(c->cpu, keys);
+}
+
+bool chip8_take_keys_read(struct chip8 *c) {
+	bool read = c->cpu->keysRead;
+	c->cpu->keysRead = false;
+	return read;
+}
+
+uint32_t chip8_read_framebuffer(struct chip8 *c, uint64_t rows[CHIP8_DISPLAY_HEIGHT]) {
+	get_current_frame(c->cpu, rows);
+	return cpu_take_dirty_rows(c->cpu);
+}
+
+unsigned long long chip8_cycles(const struct chip8 *c) {
+	return c->cpu->cycles;
+}
+
+unsigned long long chip8_idle_cycles(const struct chip8 *c) {
+	return c->cpu->idleCycles;
+}
+
+void chip8_set_wallclock_timers(struct chip8 *c, bool enabled) {
+	cpu_set_timer_mode(c->cpu, enabled ? timerModeWallClock : timerModeCycles, c->cyclesPerFrame);
+}
+
+bool chip8_set_jit(struct chip8 *c, bool enabled) {
+	return cpu_set_jit(c->cpu, enabled);
+}
+
+void chip8_set_quiet(struct chip8 *c, bool quiet) {
+	c->cpu->quiet = quiet;
+}
+
+bool chip8_trace_start(struct chip8 *c, const char *path) {
+	return trace_start(c->cpu, path);
+}
+
+long long chip8_trace_stop(struct chip8 *c) {
+	return trace_stop(c->cpu);
+}
+
+bool chip8_profile_start(struct chip8 *c) {
+#ifdef CPU_PROFILE
+	return profile_start(c->cpu);
+#else
+	return false;
+#endif
+}
+
+int chip8_profile_finish(struct chip8 *c, const char *stacksPath) {
+#ifdef CPU_PROFILE
+	if (!c->cpu->profile) return -1;
+	int result = 0;
+	//The report still gets printed if the stacks can't be written
+	FILE *stacks = stacksPath ? fopen(stacksPath, "w") : NULL;
+	if (stacksPath && !stacks) result = -1;
+	profile_report(c->cpu, stdout, stacks);
+	if (stacks && fclose(stacks) != 0) result = -1;
+	profile_stop(c->cpu);
+	return result;
+#else
+	return -1;
+#endif
+}
+
+void chip8_destroy(struct chip8 *c) {
+	if (!c) return;
+	arena_lock();
+	cpu_arena_free(&arena, c->cpu);
+	arena_unlock();
+	free(c);
+}
@@ -0,0 +1,121 @@
+//
+//  chip8.h
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#ifndef chip8_h
+#define chip8_h
+
+//libchip8, the emulator core without any front end.
+//Link against the chip8 library target and drive a machine through these calls.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "quirks.h"
+
+#define CHIP8_DISPLAY_WIDTH 64
+#define CHIP8_DISPLAY_HEIGHT 32
+//Program memory runs from 0x200 to the end of the 4KB
+#define CHIP8_MAX_ROM_SIZE (4096 - 0x200)
+
+struct chip8;
+
+//Make a machine with the given instructions per 60Hz frame (0 for the default), or NULL if out of memory.
+//Machines share nothing, so different ones can be stepped from different threads at once.
+struct chip8 *chip8_create(int cyclesPerFrame);
+
+//Load a ROM at 0x200. Returns 0 on success, -1 if the file can't be read or is empty, -2 if the ROM is too big.
+int chip8_load_rom(struct chip8 *c, const unsigned char *rom, long size);
+int chip8_load_rom_file(struct chip8 *c, const char *path);
+
+//Read a ROM file into buffer, which has room for CHIP8_MAX_ROM_SIZE bytes, for when the ROM itself is needed too.
+//Returns 0 and sets size on success, otherwise as chip8_load_rom().
+int chip8_read_rom_file(const char *path, unsigned char *buffer, long *size);
+
+//Save states hold everything about a running machine: memory, registers, stack, timers, display, keys,
+//random number state, quirk profile and instructions per frame. They're versioned, little-endian and
+//checksummed (see savestate.h), so they can be kept on disk and loaded into any number of machines.
+//Bytes a state takes
+size_t chip8_state_size(void);
+//Write the machine's state into buffer, which has room for chip8_state_size() bytes. Returns the bytes written.
+size_t chip8_save_state(struct chip8 *c, unsigned char *buffer);
+//Returns 0 on success, -2 if it isn't a state this version can read, -3 if it's corrupted.
+//The machine is left alone unless it succeeds.
+int chip8_load_state(struct chip8 *c, const unsigned char *state, size_t size);
+//As above, to and from a file. Returns -1 if the file can't be written or read.
+int chip8_save_state_file(struct chip8 *c, const char *path);
+int chip8_load_state_file(struct chip8 *c, const char *path);
+
+//Pick how ambiguous instructions behave, usually right before loading the ROM that needs it.
+//Machines start out on quirksLegacy.
+void chip8_set_quirks(struct chip8 *c, enum quirkProfile profile);
+
+//Seed the CXNN random number generator, usually right after creating the machine.
+//Each stream is its own sequence, so machines run side by side can share a seed and take a stream each.
+//Machines all start out on RNG_DEFAULT_SEED from rng.h, on stream 0.
+void chip8_set_seed(struct chip8 *c, uint64_t seed, uint64_t stream);
+//The seed and stream the machine was last given
+uint64_t chip8_seed(const struct chip8 *c);
+uint64_t chip8_stream(const struct chip8 *c);
+
+//Instructions per frame, as created or as the last loaded save state had it
+int chip8_cycles_per_frame(const struct chip8 *c);
+
+//Run up to cycles instructions, returns the number executed
+int chip8_step(struct chip8 *c, int cycles);
+
+//Run one frame worth of instructions and tick the timers, returns the number executed
+int chip8_step_frame(struct chip8 *c);
+
+//True once the CPU has stopped, on an unknown opcode or with autohalt
+bool chip8_halted(const struct chip8 *c);
+
+//True if the CPU is sitting on FX0A with no key pressed, so it won't get anywhere until input changes
+bool chip8_waiting_for_key(const struct chip8 *c);
+
+//Pressed keys, bit n is key n
+void chip8_set_keys(struct chip8 *c, uint16_t keys);
+
+//True if the ROM has looked at the keys (EX9E, EXA1 or FX0A) since the last call
+bool chip8_take_keys_read(struct chip8 *c);
+
+//Copy out the display, one word per row with the leftmost pixel in the most significant bit.
+//Returns a mask of the rows drawn to since the last call, bit n is row n.
+uint32_t chip8_read_framebuffer(struct chip8 *c, uint64_t rows[CHIP8_DISPLAY_HEIGHT]);
+
+//Instructions executed since the machine was created
+unsigned long long chip8_cycles(const struct chip8 *c);
+
+//How many of those were idle loop iterations or key waits that got fast-forwarded instead of run
+unsigned long long chip8_idle_cycles(const struct chip8 *c);
+
+//Count timers down by the host clock instead of emulated cycles
+void chip8_set_wallclock_timers(struct chip8 *c, bool enabled);
+
+//Run through the x86-64 recompiler. Returns false if it isn't built in.
+bool chip8_set_jit(struct chip8 *c, bool enabled);
+
+//Stop printing BEEP! and unknown opcode errors to stdout
+void chip8_set_quiet(struct chip8 *c, bool quiet);
+
+//Write every instruction run to a binary trace file, which chip8-trace turns into text. Can be started
+//and stopped any time between runs, and runs through the interpreter while it's on.
+//Returns false if the file can't be created.
+bool chip8_trace_start(struct chip8 *c, const char *path);
+//Finish the trace. Returns the instructions in it, or -1 if writing it failed. Destroying the machine stops it too.
+long long chip8_trace_stop(struct chip8 *c);
+
+//Count every instruction run by address, opcode and subroutine, see profile.h.
+//Returns false if the profiler wasn't built in (-DCPU_PROFILE=ON) or is out of memory.
+bool chip8_profile_start(struct chip8 *c);
+//Print the hot-spot report, write collapsed stacks for flamegraph tools to stacksPath unless it's NULL,
+//and stop profiling. Returns -1 if the stacks couldn't be written or nothing was being profiled.
+int chip8_profile_finish(struct chip8 *c, const char *stacksPath);
+
+void chip8_destroy(struct chip8 *c);
+
+#endif /* chip8_h */
@@ -0,0 +1,31 @@
+//
+//  crc32.h
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#ifndef crc32_h
+#define crc32_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+//CRC-32 (the zlib one) a nibble at a time, small enough to not need building at runtime
+static const uint32_t crcNibbles[16] = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static inline uint32_t crc32(const unsigned char *data, size_t length) {
+	uint32_t crc = 0xFFFFFFFF;
+	for (size_t i = 0; i < length; ++i) {
+		crc ^= data[i];
+		crc = (crc >> 4) ^ crcNibbles[crc & 0xF];
+		crc = (crc >> 4) ^ crcNibbles[crc & 0xF];
+	}
+	return ~crc;
+}
+
+#endif /* crc32_h */
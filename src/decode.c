@@ -0,0 +1,92 @@
+//
+//  decode.c
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#include <stdatomic.h>
+#include "decode.h"
+
+#define OP_PATTERN(pattern, description) #pattern,
+const char *opPatterns[OP_COUNT] = { OPCODE_LIST(OP_PATTERN) };
+#undef OP_PATTERN
+
+#define OP_DESCRIPTION(pattern, description) description,
+const char *opDescriptions[OP_COUNT] = { OPCODE_LIST(OP_DESCRIPTION) };
+#undef OP_DESCRIPTION
+
+byte opHandlerTable[65536];
+
+//Same decoding rules as the switch in cpu_emulate_cycle()
+enum opHandler cpu_decode_handler(unsigned short op) {
+	switch (op & 0xF000) {
+		case 0x0000:
+			switch (op & 0x000F) {
+				case 0x0000: return OP_00E0;
+				case 0x000E: return OP_00EE;
+				default: return OP_UNKNOWN;
+			}
+		case 0x1000: return OP_1NNN;
+		case 0x2000: return OP_2NNN;
+		case 0x3000: return OP_3XNN;
+		case 0x4000: return OP_4XNN;
+		case 0x5000: return OP_5XY0;
+		case 0x6000: return OP_6XNN;
+		case 0x7000: return OP_7XNN;
+		case 0x8000:
+			switch (op & 0x000F) {
+				case 0x0000: return OP_8XY0;
+				case 0x0001: return OP_8XY1;
+				case 0x0002: return OP_8XY2;
+				case 0x0003: return OP_8XY3;
+				case 0x0004: return OP_8XY4;
+				case 0x0005: return OP_8XY5;
+				case 0x0006: return OP_8XY6;
+				case 0x0007: return OP_8XY7;
+				case 0x000E: return OP_8XYE;
+				default: return OP_UNKNOWN;
+			}
+		case 0x9000: return OP_9XY0;
+		case 0xA000: return OP_ANNN;
+		case 0xB000: return OP_BNNN;
+		case 0xC000: return OP_CXNN;
+		case 0xD000: return OP_DXYN;
+		case 0xE000:
+			switch (op & 0x00FF) {
+				case 0x009E: return OP_EX9E;
+				case 0x00A1: return OP_EXA1;
+				default: return OP_UNKNOWN;
+			}
+		case 0xF000:
+			switch (op & 0x00FF) {
+				case 0x0007: return OP_FX07;
+				case 0x000A: return OP_FX0A;
+				case 0x0015: return OP_FX15;
+				case 0x0018: return OP_FX18;
+				case 0x001E: return OP_FX1E;
+				case 0x0029: return OP_FX29;
+				case 0x0033: return OP_FX33;
+				case 0x0055: return OP_FX55;
+				case 0x0065: return OP_FX65;
+				default: return OP_UNKNOWN;
+			}
+	}
+	return OP_UNKNOWN;
+}
+
+void cpu_build_decode_table() {
+	//CPUs can be initialized from several threads at once, the first one in builds the table and the rest wait
+	static atomic_int state = 0; //0 not built, 1 building, 2 built
+	if (atomic_load_explicit(&state, memory_order_acquire) == 2) return;
+	int expected = 0;
+	if (atomic_compare_exchange_strong(&state, &expected, 1)) {
+		for (int op = 0; op < 65536; ++op) {
+			opHandlerTable[op] = cpu_decode_handler(op);
+		}
+		atomic_store_explicit(&state, 2, memory_order_release);
+	} else {
+		while (atomic_load_explicit(&state, memory_order_acquire) != 2);
+	}
+}
@@ -0,0 +1,83 @@
+//
+//  decode.h
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#ifndef decode_h
+#define decode_h
+
+#include "CPU.h"
+
+//Every instruction the CPU knows, in handler index order.
+//OP(pattern, description)
+#define OPCODE_LIST(OP) \
+	OP(UNKNOWN, "Unknown opcode") \
+	OP(00E0, "Clear the screen") \
+	OP(00EE, "Return from subroutine") \
+	OP(1NNN, "Jump to address NNN") \
+	OP(2NNN, "Call subroutine at NNN") \
+	OP(3XNN, "Skip the next instruction if VX equals NN") \
+	OP(4XNN, "Skip the next instruction if VX doesn't equal NN") \
+	OP(5XY0, "Skip the next instruction if VX equals VY") \
+	OP(6XNN, "Set VX to NN") \
+	OP(7XNN, "Add NN to VX") \
+	OP(8XY0, "Set VX to the value of VY") \
+	OP(8XY1, "Set VX to VX or VY") \
+	OP(8XY2, "Set VX to VX and VY") \
+	OP(8XY3, "Set VX to VX xor VY") \
+	OP(8XY4, "Add VY to VX. VF is set to 1 when there's a carry, and to 0 when there isn't") \
+	OP(8XY5, "VY is subtracted from VX. VF is set to 0 when there's a borrow, and 1 when there isn't") \
+	OP(8XY6, "Shift VX right by one. VF is set to the value of the least significant bit of VX before the shift") \
+	OP(8XY7, "Set VX to VY minus VX. VF is set to 0 when there's a borrow, and 1 when there isn't") \
+	OP(8XYE, "Shift VX left by one. VF is set to the value of the most significant bit of VX before the shift") \
+	OP(9XY0, "Skip the next instruction if VX doesn't equal VY") \
+	OP(ANNN, "Set I to the address NNN") \
+	OP(BNNN, "Jump to NNN plus V0 (or XNN plus VX, per quirk profile)") \
+	OP(CXNN, "Set VX to the result of a bitwise and operation on a random number and NN") \
+	OP(DXYN, "Draw a sprite at coordinate (VX,VY) that has a width of 8px and a height of Npx") \
+	OP(EX9E, "Skip the next instruction if the key stored in VX is pressed") \
+	OP(EXA1, "Skip the next instruction if the key stored in VX isn't pressed") \
+	OP(FX07, "Set VX to the value of the delay timer") \
+	OP(FX0A, "Wait for key press, then store in VX") \
+	OP(FX15, "Set the delay timer to VX") \
+	OP(FX18, "Set the sound timer to VX") \
+	OP(FX1E, "Add VX to I") \
+	OP(FX29, "Set I to the location of the sprite for the character in VX") \
+	OP(FX33, "Store the binary-coded decimal representation of VX") \
+	OP(FX55, "Store V0 to VX (Including VX) in memory starting at address I") \
+	OP(FX65, "Fill V0 to VX (Including VX) with values from memory starting at address I")
+
+#define OP_ENUM(pattern, description) OP_##pattern,
+enum opHandler {
+	OPCODE_LIST(OP_ENUM)
+	OP_COUNT
+};
+#undef OP_ENUM
+
+//Marks an empty decode cache entry
+#define OP_NOT_DECODED 0xFF
+
+extern const char *opPatterns[OP_COUNT];
+extern const char *opDescriptions[OP_COUNT];
+
+//Handler index for every possible 16 bit opcode, see cpu_build_decode_table()
+extern byte opHandlerTable[65536];
+
+enum opHandler cpu_decode_handler(unsigned short op);
+void cpu_build_decode_table(void);
+
+static inline struct instr cpu_decode(unsigned short op) {
+	struct instr in;
+	in.op = op;
+	in.handler = opHandlerTable[op];
+	in.x = (op & 0x0F00) >> 8;
+	in.y = (op & 0x00F0) >> 4;
+	in.nn = op & 0x00FF;
+	in.nnn = op & 0x0FFF;
+	return in;
+}
+
+#endif /* decode_h */
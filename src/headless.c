@@ -0,0 +1,320 @@
+//
+//  headless.c
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+//chip8-headless, runs a ROM through libchip8 with no window, audio or SDL.
+//Prints how far it got, how fast, and a hash of the final display so runs can be compared.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chip8.h"
+#include "movie.h"
+#include "metrics.h"
+#include "rewind.h"
+#include "rng.h"
+#include "scheduler.h"
+#include "timing.h"
+
+static void print_usage(char *name) {
+	printf("Usage: %s [--ipf <instructions per frame>] [--frames <n>] [--keys <hex mask>] [--realtime] [--jit] [--quirks <profile>] [--seed <n>] [--stream <n>] [--load-state <file>] [--save-state <file>] [--rewind <frames>] [--record <movie>] [--replay <movie>] [--trace <file>] [--trace-from <frame>] [--profile <stacks file>] [--stats <file>] [--stats-socket <path>] [--dump] <ROM>\n", name);
+	printf("With --load-state the ROM can be left out, the machine carries on from the saved state.\n");
+	printf("--replay runs the ROM with the keys and settings of a movie, and checks it ends up where the recording did.\n");
+	printf("--trace writes every instruction run to a file for chip8-trace, from the start or from --trace-from.\n");
+	printf("--profile prints where the cycles went, and writes collapsed stacks for flamegraph tools. Needs -DCPU_PROFILE=ON.\n");
+	printf("--stats and --stats-socket export frame time, instructions per second and drift for a collector to scrape.\n");
+}
+
+//FNV-1a over the display rows
+static unsigned long long hash_display(const uint64_t *rows) {
+	unsigned long long hash = 0xcbf29ce484222325ULL;
+	for (int r = 0; r < CHIP8_DISPLAY_HEIGHT; ++r) {
+		for (int b = 0; b < 8; ++b) {
+			hash ^= (rows[r] >> (b * 8)) & 0xFF;
+			hash *= 0x100000001b3ULL;
+		}
+	}
+	return hash;
+}
+
+static void dump_display(const uint64_t *rows) {
+	for (int r = 0; r < CHIP8_DISPLAY_HEIGHT; ++r) {
+		for (int x = 0; x < CHIP8_DISPLAY_WIDTH; ++x) {
+			putchar((rows[r] >> (63 - x)) & 1 ? '#' : '.');
+		}
+		putchar('\n');
+	}
+}
+
+int main(int argc, char *argv[]) {
+	int cyclesPerFrame = 0;
+	long frames = 600;
+	uint16_t keys = 0;
+	bool keysGiven = false;
+	bool realtime = false;
+	bool jit = false;
+	enum quirkProfile quirks = quirksLegacy;
+	uint64_t seed = RNG_DEFAULT_SEED;
+	uint64_t stream = 0;
+	bool dump = false;
+	char *romPath = NULL;
+	char *loadPath = NULL;
+	char *savePath = NULL;
+	long rewindFrames = 0;
+	char *recordPath = NULL;
+	char *replayPath = NULL;
+	char *tracePath = NULL;
+	long traceFrom = 0;
+	char *profilePath = NULL;
+	char *statsPath = NULL;
+	char *statsSocket = NULL;
+	
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--ipf") == 0 && i + 1 < argc) {
+			cyclesPerFrame = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+			frames = atol(argv[++i]);
+		} else if (strcmp(argv[i], "--keys") == 0 && i + 1 < argc) {
+			keys = (uint16_t)strtoul(argv[++i], NULL, 16);
+			keysGiven = true;
+		} else if (strcmp(argv[i], "--realtime") == 0) {
+			realtime = true;
+		} else if (strcmp(argv[i], "--jit") == 0) {
+			jit = true;
+		} else if (strcmp(argv[i], "--quirks") == 0 && i + 1 < argc) {
+			if (!quirks_find(argv[++i], &quirks)) {
+				printf("Unknown quirk profile %s, use legacy, vip, chip48, schip or modern\n", argv[i]);
+				return -1;
+			}
+		} else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			seed = strtoull(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc) {
+			stream = strtoull(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "--load-state") == 0 && i + 1 < argc) {
+			loadPath = argv[++i];
+		} else if (strcmp(argv[i], "--save-state") == 0 && i + 1 < argc) {
+			savePath = argv[++i];
+		} else if (strcmp(argv[i], "--rewind") == 0 && i + 1 < argc) {
+			rewindFrames = atol(argv[++i]);
+		} else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			recordPath = argv[++i];
+		} else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+			replayPath = argv[++i];
+		} else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			tracePath = argv[++i];
+		} else if (strcmp(argv[i], "--trace-from") == 0 && i + 1 < argc) {
+			traceFrom = atol(argv[++i]);
+		} else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+			profilePath = argv[++i];
+		} else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+			statsPath = argv[++i];
+		} else if (strcmp(argv[i], "--stats-socket") == 0 && i + 1 < argc) {
+			statsSocket = argv[++i];
+		} else if (strcmp(argv[i], "--dump") == 0) {
+			dump = true;
+		} else if (!romPath) {
+			romPath = argv[i];
+		} else {
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+	if ((!romPath && !loadPath) || frames < 1) {
+		print_usage(argv[0]);
+		return -1;
+	}
+	//Movies start from the ROM, and only stay in sync if nothing else changes the run
+	if ((recordPath || replayPath) && (loadPath || rewindFrames > 0 || !romPath)) {
+		printf("--record and --replay need a ROM, and don't go with --load-state or --rewind\n");
+		return -1;
+	}
+	
+	//A replay runs with the settings it was recorded with, for as long as the recording went
+	static struct movie movie;
+	if (replayPath) {
+		switch (movie_load(&movie, replayPath)) {
+			case -1:
+				printf("Couldn't read the movie %s\n", replayPath);
+				return -1;
+			case -2:
+				printf("%s isn't a movie this version can read\n", replayPath);
+				return -1;
+			default:
+				break;
+		}
+		cyclesPerFrame = movie.cyclesPerFrame;
+		frames = movie.frames;
+	}
+	
+	struct chip8 *machine = chip8_create(cyclesPerFrame);
+	if (!machine) {
+		printf("Couldn't create the emulator\n");
+		return -1;
+	}
+	if (loadPath) {
+		//The state brings its own memory, quirks and instructions per frame
+		switch (chip8_load_state_file(machine, loadPath)) {
+			case -1:
+				printf("Couldn't read the save state %s\n", loadPath);
+				return -1;
+			case -2:
+				printf("%s isn't a save state this version can read\n", loadPath);
+				return -1;
+			case -3:
+				printf("Save state %s is corrupted\n", loadPath);
+				return -1;
+			default:
+				break;
+		}
+	} else {
+		static unsigned char rom[CHIP8_MAX_ROM_SIZE];
+		long romSize = 0;
+		//Read rather than loaded straight in, movies keep the ROM's CRC to check against
+		int result = chip8_read_rom_file(romPath, rom, &romSize);
+		if (result == 0 && replayPath) {
+			result = movie_start_replay(&movie, machine, rom, romSize);
+			if (result == -1) {
+				printf("%s was recorded with a different ROM\n", replayPath);
+				return -1;
+			}
+		} else if (result == 0) {
+			chip8_set_seed(machine, seed, stream);
+			chip8_set_quirks(machine, quirks);
+			result = chip8_load_rom(machine, rom, romSize);
+			if (recordPath) movie_init(&movie, machine, quirks, rom, romSize);
+		}
+		switch (result) {
+			case -1:
+				printf("Couldn't find the ROM file! (Check working dir/path)\n");
+				return -1;
+			case -2:
+				printf("ROM too big\n");
+				return -1;
+			default:
+				break;
+		}
+	}
+	if (jit && !chip8_set_jit(machine, true)) {
+		printf("JIT recompiler not built in, using the interpreter\n");
+	}
+	//A loaded state keeps the keys it was saved with, unless told otherwise
+	if (!loadPath || keysGiven) {
+		chip8_set_keys(machine, keys);
+	}
+	
+	if (profilePath && !chip8_profile_start(machine)) {
+		printf("Profiler not built in, configure with -DCPU_PROFILE=ON\n");
+		return -1;
+	}
+	
+	//With --rewind, every frame is recorded and the run is stepped back through at the end
+	static struct rewind_buffer history;
+	if (rewindFrames > 0 && !rewind_init(&history, REWIND_DEFAULT_BUDGET)) {
+		printf("Couldn't set up the rewind buffer\n");
+		return -1;
+	}
+	
+	//Realtime paces frames at 60Hz like the SDL front end, otherwise run flat out
+	struct scheduler sched;
+	scheduler_init(&sched, !realtime);
+	//Render and input times stay empty, there's no window
+	static struct metrics metrics;
+	static struct metrics_exporter exporter;
+	if (statsPath || statsSocket) {
+		metrics_init(&metrics);
+		scheduler_set_metrics(&sched, &metrics);
+		if (!metrics_export_start(&exporter, &metrics, statsPath, statsSocket)) {
+			printf("Couldn't export the metrics to %s\n", statsSocket ? statsSocket : statsPath);
+			return -1;
+		}
+	}
+	long frame = 0;
+	while (frame < frames) {
+		if (rewindFrames > 0) rewind_record(&history, machine);
+		if (tracePath && frame == traceFrom && !chip8_trace_start(machine, tracePath)) {
+			printf("Couldn't start the trace %s\n", tracePath);
+			return -1;
+		}
+		if (replayPath) {
+			movie_replay_frame(&movie, &keys);
+			chip8_set_keys(machine, keys);
+		} else if (recordPath && !movie_record_frame(&movie, keys)) {
+			printf("Out of memory for the movie\n");
+			return -1;
+		}
+		bool running = scheduler_run_frame(&sched, machine);
+		frame++;
+		if (!running) break;
+		scheduler_wait(&sched);
+	}
+	
+	if (statsPath || statsSocket) metrics_export_stop(&exporter);
+	
+	//Stopped before rewinding, the last instruction's changes are read off the machine, and rewinding isn't the ROM's time
+	int result = 0;
+	if (tracePath) {
+		long long traced = chip8_trace_stop(machine);
+		if (traced < 0) {
+			printf("Couldn't write the trace %s\n", tracePath);
+			result = -1;
+		} else {
+			printf("Traced %lld instructions to %s\n", traced, tracePath);
+		}
+	}
+	if (profilePath && chip8_profile_finish(machine, profilePath) != 0) {
+		printf("Couldn't write the stacks %s\n", profilePath);
+		result = -1;
+	}
+	
+	if (rewindFrames > 0) {
+		long long slowest = 0;
+		long stepped = 0;
+		while (stepped < rewindFrames) {
+			long long start = time_now_ns();
+			if (!rewind_step_back(&history, machine)) break;
+			long long taken = time_now_ns() - start;
+			if (taken > slowest) slowest = taken;
+			stepped++;
+		}
+		frame -= stepped;
+		rewind_print_stats(&history);
+		printf("Stepped back %ld frames, slowest step %.1fus\n", stepped, slowest / 1000.0);
+		rewind_destroy(&history);
+	}
+	
+	if (recordPath) {
+		movie_finish(&movie, machine);
+		if (movie_save(&movie, recordPath) != 0) {
+			printf("Couldn't write the movie %s\n", recordPath);
+			result = -1;
+		}
+	}
+	if (replayPath) {
+		if (movie_check(&movie, machine)) {
+			printf("Replay matches the recording\n");
+		} else {
+			printf("Replay out of sync, the recording ended on %llu cycles and display hash %016llx\n", movie.cycles, movie.displayHash);
+			result = 1;
+		}
+	}
+	movie_destroy(&movie);
+	
+	uint64_t rows[CHIP8_DISPLAY_HEIGHT];
+	chip8_read_framebuffer(machine, rows);
+	if (dump) {
+		dump_display(rows);
+	}
+	scheduler_print_stats(&sched);
+	printf("%s after %ld frames, display hash %016llx\n", chip8_halted(machine) ? "Halted" : "Stopped",
+		   frame, hash_display(rows));
+	if (savePath && chip8_save_state_file(machine, savePath) != 0) {
+		printf("Couldn't write the save state %s\n", savePath);
+	}
+	
+	chip8_destroy(machine);
+	return result;
+}
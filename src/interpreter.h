@@ -0,0 +1,138 @@
+//
+//  interpreter.h
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+//The interpreter loop, as a template. CPU.c includes this once per quirk profile, with QUIRK_PROFILE
+//set, which gives execute_<profile>() and interpret_<profile>() built around that profile's handlers.
+//interpret_<profile>() runs until cpu->cycles reaches cpu->cycleLimit, which cpu_run() sets.
+//Nothing else should include this.
+
+#include "ops.h"
+
+#if defined(CPU_DISPATCH_TABLE) || defined(CPU_DISPATCH_THREADED)
+
+#define OP_FUNC(pattern, description) PROFILED(op_##pattern),
+static void (*const PROFILED(opFuncs)[OP_COUNT])(chipCPU *, struct instr) = { OPCODE_LIST(OP_FUNC) };
+#undef OP_FUNC
+
+static void PROFILED(execute)(chipCPU *cpu) {
+	struct instr in = fetch_decoded(cpu);
+	PROFILED(opFuncs)[in.handler](cpu, in);
+}
+
+#else
+
+static void PROFILED(execute)(chipCPU *cpu) {
+	unsigned short op = fetch(cpu);
+	struct instr in = { .op = op, .x = (op & 0x0F00) >> 8, .y = (op & 0x00F0) >> 4, .nn = op & 0x00FF, .nnn = op & 0x0FFF };
+	
+	//Decode opcode and execute
+	switch (op & 0xF000) { //Compare the FIRST 4 bits
+		case 0x0000:
+			//In some cases the first 4 bits don't tell us the opcode, in that case check the last 4 bits
+			switch (op & 0x000F) { //Compare the LAST 4 bits
+				case 0x0000: PROFILED(op_00E0)(cpu, in); break;
+				case 0x000E: PROFILED(op_00EE)(cpu, in); break;
+				default:
+					PROFILED(op_UNKNOWN)(cpu, in);
+					break;
+			}
+			break;
+		case 0x1000: PROFILED(op_1NNN)(cpu, in); break;
+		case 0x2000: PROFILED(op_2NNN)(cpu, in); break;
+		case 0x3000: PROFILED(op_3XNN)(cpu, in); break;
+		case 0x4000: PROFILED(op_4XNN)(cpu, in); break;
+		case 0x5000: PROFILED(op_5XY0)(cpu, in); break;
+		case 0x6000: PROFILED(op_6XNN)(cpu, in); break;
+		case 0x7000: PROFILED(op_7XNN)(cpu, in); break;
+		case 0x8000: //0x8000 has 9 different opcodes, so we check the last 4 bits again to see which one it is
+			switch (op & 0x000F) {
+				case 0x0000: PROFILED(op_8XY0)(cpu, in); break;
+				case 0x0001: PROFILED(op_8XY1)(cpu, in); break;
+				case 0x0002: PROFILED(op_8XY2)(cpu, in); break;
+				case 0x0003: PROFILED(op_8XY3)(cpu, in); break;
+				case 0x0004: PROFILED(op_8XY4)(cpu, in); break;
+				case 0x0005: PROFILED(op_8XY5)(cpu, in); break;
+				case 0x0006: PROFILED(op_8XY6)(cpu, in); break;
+				case 0x0007: PROFILED(op_8XY7)(cpu, in); break;
+				case 0x000E: PROFILED(op_8XYE)(cpu, in); break;
+				default:
+					PROFILED(op_UNKNOWN)(cpu, in);
+					break;
+			}
+			break;
+		case 0x9000: PROFILED(op_9XY0)(cpu, in); break;
+		case 0xA000: PROFILED(op_ANNN)(cpu, in); break;
+		case 0xB000: PROFILED(op_BNNN)(cpu, in); break;
+		case 0xC000: PROFILED(op_CXNN)(cpu, in); break;
+		case 0xD000: PROFILED(op_DXYN)(cpu, in); break;
+		case 0xE000: //Input opcodes
+			switch (op & 0x00FF) {
+				case 0x009E: PROFILED(op_EX9E)(cpu, in); break;
+				case 0x00A1: PROFILED(op_EXA1)(cpu, in); break;
+				default:
+					PROFILED(op_UNKNOWN)(cpu, in);
+					break;
+			}
+			break;
+		case 0xF000:
+			switch (op & 0x00FF) {
+				case 0x0007: PROFILED(op_FX07)(cpu, in); break;
+				case 0x000A: PROFILED(op_FX0A)(cpu, in); break;
+				case 0x0015: PROFILED(op_FX15)(cpu, in); break;
+				case 0x0018: PROFILED(op_FX18)(cpu, in); break;
+				case 0x001E: PROFILED(op_FX1E)(cpu, in); break;
+				case 0x0029: PROFILED(op_FX29)(cpu, in); break;
+				case 0x0033: PROFILED(op_FX33)(cpu, in); break;
+				case 0x0055: PROFILED(op_FX55)(cpu, in); break;
+				case 0x0065: PROFILED(op_FX65)(cpu, in); break;
+				default:
+					PROFILED(op_UNKNOWN)(cpu, in);
+					break;
+			}
+			break;
+		default:
+			PROFILED(op_UNKNOWN)(cpu, in);
+			break;
+	}
+}
+
+#endif
+
+#ifdef CPU_DISPATCH_THREADED
+
+//Threaded interpreter, each handler jumps straight to the next one through a computed goto
+//instead of returning to a central dispatch loop.
+static void PROFILED(interpret)(chipCPU *cpu) {
+	#define OP_LABEL_ADDR(pattern, description) &&do_##pattern,
+	static void *const labels[OP_COUNT] = { OPCODE_LIST(OP_LABEL_ADDR) };
+	#undef OP_LABEL_ADDR
+	
+	struct instr in;
+	
+	#define DISPATCH() \
+		if (cpu->cycles >= cpu->cycleLimit || !cpu->running) return; \
+		in = fetch_decoded(cpu); \
+		goto *labels[in.handler];
+	
+	DISPATCH();
+	
+	#define OP_LABEL(pattern, description) do_##pattern: PROFILED(op_##pattern)(cpu, in); DISPATCH();
+	OPCODE_LIST(OP_LABEL)
+	#undef OP_LABEL
+	#undef DISPATCH
+}
+
+#else
+
+static void PROFILED(interpret)(chipCPU *cpu) {
+	while (cpu->cycles < cpu->cycleLimit && cpu->running) {
+		PROFILED(execute)(cpu);
+	}
+}
+
+#endif
@@ -0,0 +1,425 @@
+//
+//  jit.c
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+//x86-64 basic block recompiler.
+//A block starts at some PC and runs until a control flow instruction (1NNN, 2NNN, 00EE, skips),
+//or until an instruction we don't translate. Control flow we translate ends the block in native code,
+//everything else (BNNN, FX0A, DXYN, timers, memory writes...) is left for the interpreter to run
+//once the block returns. So a block never writes to memory, and never sees a timer mid-block.
+//Translated code is a plain function, int block(chipCPU *cpu), returning the number of instructions it ran.
+
+#include "jit.h"
+
+#ifdef CPU_JIT
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "decode.h"
+
+//Per CPU. Pages are only backed once code is written to them, so this is mostly address space.
+#define CODE_BUFFER_SIZE (1024 * 1024)
+//Longest block we translate, in instructions
+#define MAX_BLOCK_LENGTH 64
+//Worst case native code for one block
+#define MAX_BLOCK_BYTES (MAX_BLOCK_LENGTH * 48 + 64)
+
+//Scratch registers, we only touch caller saved ones. rdi holds the chipCPU pointer.
+#define EAX 0
+#define ECX 1
+#define EDX 2
+
+typedef int (*blockFunc)(chipCPU *);
+
+struct jitBlock {
+	blockFunc code;
+	unsigned short length; //Instructions
+	unsigned short bytes;  //Program bytes covered
+	//First instruction can't be translated, don't try again until the memory changes
+	bool untranslatable;
+	//Ends on a backward 1NNN, which the idle detector wants to hear about. Address of the jump.
+	bool idleJump;
+	unsigned short jumpAddr;
+};
+
+struct jitState {
+	struct jitBlock blocks[MEMORY_SIZE];
+	//How many blocks cover each byte of memory, so writes to data can skip invalidation cheaply
+	byte coverage[MEMORY_SIZE];
+	byte *codeBuffer;
+	size_t codeUsed;
+	//The buffer couldn't be made executable, everything runs on the interpreter
+	bool disabled;
+};
+
+//Only used while a block is being compiled, which never spans threads
+static _Thread_local byte *emitPtr;
+
+static inline void emit8(byte b) {
+	*emitPtr++ = b;
+}
+
+static inline void emit16(uint16_t v) {
+	emit8(v & 0xFF);
+	emit8(v >> 8);
+}
+
+static inline void emit32(uint32_t v) {
+	emit16(v & 0xFFFF);
+	emit16(v >> 16);
+}
+
+#define V_OFFSET(x) (uint32_t)(offsetof(chipCPU, V) + (x))
+#define I_OFFSET (uint32_t)offsetof(chipCPU, I)
+#define PC_OFFSET (uint32_t)offsetof(chipCPU, progCounter)
+#define SP_OFFSET (uint32_t)offsetof(chipCPU, stackPointer)
+#define STACK_OFFSET (uint32_t)offsetof(chipCPU, stack)
+
+//movzx reg, byte [rdi + V[x]]
+static void emit_load_v(int reg, int x) {
+	emit8(0x0F); emit8(0xB6); emit8(0x87 | reg << 3); emit32(V_OFFSET(x));
+}
+
+//mov byte [rdi + V[x]], reg8
+static void emit_store_v(int reg, int x) {
+	emit8(0x88); emit8(0x87 | reg << 3); emit32(V_OFFSET(x));
+}
+
+//mov word [rdi + offset], imm16
+static void emit_store_word_imm(uint32_t offset, uint16_t value) {
+	emit8(0x66); emit8(0xC7); emit8(0x87); emit32(offset); emit16(value);
+}
+
+//movzx reg, word [rdi + offset]
+static void emit_load_word(int reg, uint32_t offset) {
+	emit8(0x0F); emit8(0xB7); emit8(0x87 | reg << 3); emit32(offset);
+}
+
+//mov word [rdi + offset], reg16
+static void emit_store_word(int reg, uint32_t offset) {
+	emit8(0x66); emit8(0x89); emit8(0x87 | reg << 3); emit32(offset);
+}
+
+//mov eax, count; ret
+static void emit_return(int count) {
+	emit8(0xB8); emit32(count);
+	emit8(0xC3);
+}
+
+//PC = cond ? taken : notTaken, with the flags already set by a compare
+static void emit_select_pc(byte cmovOpcode, uint16_t taken, uint16_t notTaken) {
+	emit8(0xB9); emit32(notTaken); //mov ecx, notTaken
+	emit8(0xBA); emit32(taken);    //mov edx, taken
+	emit8(0x0F); emit8(cmovOpcode); emit8(0xCA); //cmovcc ecx, edx
+	emit_store_word(ECX, PC_OFFSET);
+}
+
+#define CMOVE  0x44
+#define CMOVNE 0x45
+
+//Instructions that end a block, and that we translate
+static bool is_block_end(struct instr in) {
+	switch (in.handler) {
+		case OP_1NNN:
+		case OP_2NNN:
+		case OP_00EE:
+		case OP_3XNN:
+		case OP_4XNN:
+		case OP_5XY0:
+		case OP_9XY0:
+			return true;
+		default:
+			return false;
+	}
+}
+
+//Emit native code for one instruction at pc, as the given quirk profile has it. Returns false if we don't translate it.
+static bool translate(struct instr in, unsigned short pc, const struct quirks *quirks) {
+	//Flag setting ALU ops write VF before VX, so X or Y being F needs the interpreter's ordering
+	bool touchesVF = in.x == 0xF || in.y == 0xF;
+	switch (in.handler) {
+		case OP_1NNN:
+			if (AUTOHALT) return false;
+			emit_store_word_imm(PC_OFFSET, in.nnn);
+			return true;
+		case OP_2NNN:
+			emit_load_word(EAX, SP_OFFSET);
+			//mov word [rdi + rax*2 + stack], pc + 2
+			emit8(0x66); emit8(0xC7); emit8(0x84); emit8(0x47); emit32(STACK_OFFSET); emit16(pc + 2);
+			//inc word [rdi + stackPointer]
+			emit8(0x66); emit8(0xFF); emit8(0x87); emit32(SP_OFFSET);
+			emit_store_word_imm(PC_OFFSET, in.nnn);
+			return true;
+		case OP_00EE:
+			//dec word [rdi + stackPointer]
+			emit8(0x66); emit8(0xFF); emit8(0x8F); emit32(SP_OFFSET);
+			emit_load_word(EAX, SP_OFFSET);
+			//movzx ecx, word [rdi + rax*2 + stack]
+			emit8(0x0F); emit8(0xB7); emit8(0x8C); emit8(0x47); emit32(STACK_OFFSET);
+			emit_store_word(ECX, PC_OFFSET);
+			return true;
+		case OP_3XNN:
+		case OP_4XNN:
+			emit_load_v(EAX, in.x);
+			emit8(0x3C); emit8(in.nn); //cmp al, nn
+			emit_select_pc(in.handler == OP_3XNN ? CMOVE : CMOVNE, pc + 4, pc + 2);
+			return true;
+		case OP_5XY0:
+		case OP_9XY0:
+			emit_load_v(EAX, in.x);
+			emit8(0x3A); emit8(0x87); emit32(V_OFFSET(in.y)); //cmp al, byte [rdi + V[y]]
+			emit_select_pc(in.handler == OP_5XY0 ? CMOVE : CMOVNE, pc + 4, pc + 2);
+			return true;
+		case OP_6XNN:
+			//mov byte [rdi + V[x]], nn
+			emit8(0xC6); emit8(0x87); emit32(V_OFFSET(in.x)); emit8(in.nn);
+			return true;
+		case OP_7XNN:
+			//add byte [rdi + V[x]], nn
+			emit8(0x80); emit8(0x87); emit32(V_OFFSET(in.x)); emit8(in.nn);
+			return true;
+		case OP_8XY0:
+			emit_load_v(EAX, in.y);
+			emit_store_v(EAX, in.x);
+			return true;
+		case OP_8XY1:
+		case OP_8XY2:
+		case OP_8XY3: {
+			byte aluOpcode = in.handler == OP_8XY1 ? 0x08 : in.handler == OP_8XY2 ? 0x20 : 0x30;
+			emit_load_v(EAX, in.x);
+			emit_load_v(ECX, in.y);
+			emit8(aluOpcode); emit8(0xC8); //or/and/xor al, cl
+			emit_store_v(EAX, in.x);
+			if (quirks->logicResetsVF) {
+				//mov byte [rdi + V[F]], 0
+				emit8(0xC6); emit8(0x87); emit32(V_OFFSET(0xF)); emit8(0);
+			}
+			return true;
+		}
+		case OP_8XY4:
+		case OP_8XY5:
+		case OP_8XY7:
+			if (touchesVF) return false;
+			if (in.handler == OP_8XY7) {
+				emit_load_v(EAX, in.y);
+				emit_load_v(ECX, in.x);
+			} else {
+				emit_load_v(EAX, in.x);
+				emit_load_v(ECX, in.y);
+			}
+			if (in.handler == OP_8XY4) {
+				emit8(0x00); emit8(0xC8); //add al, cl
+				emit8(0x0F); emit8(0x92); emit8(0xC2); //setc dl
+			} else {
+				emit8(0x28); emit8(0xC8); //sub al, cl
+				emit8(0x0F); emit8(0x93); emit8(0xC2); //setnc dl, VF is 1 when there's no borrow
+			}
+			emit_store_v(EDX, 0xF);
+			emit_store_v(EAX, in.x);
+			return true;
+		case OP_8XY6:
+		case OP_8XYE:
+			if (touchesVF) return false;
+			emit_load_v(EAX, quirks->shiftUsesVY ? in.y : in.x);
+			emit8(0x88); emit8(0xC2); //mov dl, al
+			if (in.handler == OP_8XY6) {
+				emit8(0x80); emit8(0xE2); emit8(0x01); //and dl, 1
+				emit8(0xD0); emit8(0xE8); //shr al, 1
+			} else {
+				emit8(0xC0); emit8(0xEA); emit8(0x07); //shr dl, 7
+				emit8(0xD0); emit8(0xE0); //shl al, 1
+			}
+			emit_store_v(EDX, 0xF);
+			emit_store_v(EAX, in.x);
+			return true;
+		case OP_ANNN:
+			emit_store_word_imm(I_OFFSET, in.nnn);
+			return true;
+		case OP_FX1E:
+			if (touchesVF) return false;
+			emit_load_word(EAX, I_OFFSET);
+			emit_load_v(ECX, in.x);
+			emit8(0x01); emit8(0xC8); //add eax, ecx
+			emit8(0x3D); emit32(0xFFF); //cmp eax, 0xFFF
+			emit8(0x0F); emit8(0x97); emit8(0xC2); //seta dl
+			emit_store_v(EDX, 0xF);
+			emit_store_word(EAX, I_OFFSET);
+			return true;
+		case OP_FX29:
+			emit_load_v(EAX, in.x);
+			emit8(0x8D); emit8(0x04); emit8(0x80); //lea eax, [rax + rax*4]
+			emit_store_word(EAX, I_OFFSET);
+			return true;
+		default:
+			return false;
+	}
+}
+
+static struct jitState *jit_state(chipCPU *cpu) {
+	if (cpu->jit) return cpu->jit->disabled ? NULL : cpu->jit;
+	struct jitState *jit = calloc(1, sizeof(*jit));
+	if (!jit) return NULL;
+	//Never writable and executable at once, see compile()
+	void *mem = mmap(NULL, CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED) {
+		printf("JIT couldn't map executable memory, using the interpreter\n");
+		free(jit);
+		return NULL;
+	}
+	jit->codeBuffer = mem;
+	cpu->jit = jit;
+	return jit;
+}
+
+static void cover(struct jitState *jit, unsigned short start, int bytes, int delta) {
+	for (int a = start; a < start + bytes && a < MEMORY_SIZE; ++a) {
+		jit->coverage[a] += delta;
+	}
+}
+
+//Translate the block starting at pc into the buffer, which has to be writable
+static struct jitBlock *emit_block(chipCPU *cpu, unsigned short pc) {
+	struct jitState *jit = cpu->jit;
+	struct jitBlock *block = &jit->blocks[pc];
+	emitPtr = jit->codeBuffer + jit->codeUsed;
+	byte *start = emitPtr;
+	unsigned short addr = pc;
+	int length = 0;
+	block->idleJump = false;
+	while (length < MAX_BLOCK_LENGTH && addr < MEMORY_SIZE - 1) {
+		struct instr in = cpu_decode(cpu->memory[addr] << 8 | cpu->memory[addr + 1]);
+		if (!translate(in, addr, &quirkProfiles[cpu->quirks])) break;
+		length++;
+		addr += 2;
+		if (is_block_end(in)) {
+			if (in.handler == OP_1NNN && in.nnn <= addr - 2) {
+				block->idleJump = true;
+				block->jumpAddr = addr - 2;
+			}
+			emit_return(length);
+			goto done;
+		}
+	}
+	if (length == 0) {
+		block->untranslatable = true;
+		block->bytes = 2;
+		cover(jit, pc, 2, 1);
+		return NULL;
+	}
+	//Fell out of the block on something we don't translate, hand it over to the interpreter
+	emit_store_word_imm(PC_OFFSET, addr);
+	emit_return(length);
+done:
+	block->code = (blockFunc)start;
+	block->length = length;
+	block->bytes = addr - pc;
+	jit->codeUsed += emitPtr - start;
+	cover(jit, pc, block->bytes, 1);
+	return block;
+}
+
+//The buffer is never writable and executable at once. Only the pages the next block can land on are
+//made writable while it's emitted, the rest stay executable. ROMs that write next to their code
+//recompile often, so this keeps each flip to a page or two.
+static struct jitBlock *compile(chipCPU *cpu, unsigned short pc) {
+	struct jitState *jit = cpu->jit;
+	if (jit->disabled) return NULL;
+	if (jit->codeUsed + MAX_BLOCK_BYTES > CODE_BUFFER_SIZE) {
+		//Out of space, start over
+		jit_flush(cpu);
+	}
+	static size_t pageSize;
+	if (!pageSize) pageSize = (size_t)sysconf(_SC_PAGESIZE);
+	size_t first = jit->codeUsed & ~(pageSize - 1);
+	size_t last = (jit->codeUsed + MAX_BLOCK_BYTES + pageSize - 1) & ~(pageSize - 1);
+	if (last > CODE_BUFFER_SIZE) last = CODE_BUFFER_SIZE;
+	if (mprotect(jit->codeBuffer + first, last - first, PROT_READ | PROT_WRITE) != 0) {
+		printf("JIT couldn't make its code writable, using the interpreter\n");
+		jit->disabled = true;
+		return NULL;
+	}
+	struct jitBlock *block = emit_block(cpu, pc);
+	if (mprotect(jit->codeBuffer + first, last - first, PROT_READ | PROT_EXEC) != 0) {
+		printf("JIT couldn't make its code executable, using the interpreter\n");
+		jit_flush(cpu);
+		jit->disabled = true;
+		return NULL;
+	}
+	return block;
+}
+
+static void drop(struct jitState *jit, unsigned short addr) {
+	struct jitBlock *block = &jit->blocks[addr];
+	if (block->code || block->untranslatable) {
+		cover(jit, addr, block->bytes, -1);
+		block->code = NULL;
+		block->untranslatable = false;
+	}
+}
+
+void jit_invalidate(chipCPU *cpu, int addr, int length) {
+	struct jitState *jit = cpu->jit;
+	if (!jit) return;
+	for (int a = addr; a < addr + length && a < MEMORY_SIZE; ++a) {
+		if (jit->coverage[a] == 0) continue;
+		//A block covering a starts at most MAX_BLOCK_LENGTH instructions before it
+		int first = a - MAX_BLOCK_LENGTH * 2;
+		for (int b = first < 0 ? 0 : first; b <= a; ++b) {
+			if (b + jit->blocks[b].bytes > a) drop(jit, b);
+		}
+	}
+}
+
+void jit_flush(chipCPU *cpu) {
+	struct jitState *jit = cpu->jit;
+	if (!jit) return;
+	memset(jit->blocks, 0, sizeof(jit->blocks));
+	memset(jit->coverage, 0, sizeof(jit->coverage));
+	jit->codeUsed = 0;
+}
+
+void jit_destroy(chipCPU *cpu) {
+	struct jitState *jit = cpu->jit;
+	if (!jit) return;
+	munmap(jit->codeBuffer, CODE_BUFFER_SIZE);
+	free(jit);
+	cpu->jit = NULL;
+}
+
+void jit_run(chipCPU *cpu) {
+	struct jitState *jit = jit_state(cpu);
+	if (!jit) {
+		while (cpu->cycles < cpu->cycleLimit && cpu->running) {
+			cpu_emulate_cycle(cpu);
+		}
+		return;
+	}
+	
+	while (cpu->cycles < cpu->cycleLimit && cpu->running) {
+		unsigned short pc = cpu->progCounter;
+		struct jitBlock *block = NULL;
+		if (pc >= PROGRAM_START && pc < MEMORY_SIZE - 1) {
+			block = &jit->blocks[pc];
+			if (!block->code && !block->untranslatable) {
+				block = compile(cpu, pc);
+			} else if (!block->code) {
+				block = NULL;
+			}
+		}
+		//Only run a block if it fits in the budget, so cycle counts match the interpreter exactly
+		if (block && block->length <= cpu->cycleLimit - cpu->cycles) {
+			cpu->cycles += block->code(cpu);
+			if (block->idleJump) cpu_idle_jump(cpu, block->jumpAddr);
+		} else {
+			cpu_emulate_cycle(cpu);
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,31 @@
+//
+//  jit.h
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#ifndef jit_h
+#define jit_h
+
+#include "CPU.h"
+
+#ifdef CPU_JIT
+
+//Run until cpu->cycleLimit through translated basic blocks, falling back to
+//cpu_emulate_cycle() for anything the recompiler doesn't handle.
+void jit_run(chipCPU *cpu);
+
+//Drop translated blocks that cover any byte in [addr, addr + length)
+void jit_invalidate(chipCPU *cpu, int addr, int length);
+
+//Drop every translated block
+void jit_flush(chipCPU *cpu);
+
+//Free the CPU's translated code and block table
+void jit_destroy(chipCPU *cpu);
+
+#endif
+
+#endif /* jit_h */
@@ -0,0 +1,750 @@
+//
+//  lockstep.c
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "lockstep.h"
+#include "CPU.h"
+#include "decode.h"
+
+//Loops over lanes are kept branch free so the compiler vectorizes them.
+//With GCC on x86-64 Linux they're also built for AVX2, and the best version is picked when the program loads.
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+#define LANE_LOOP __attribute__((target_clones("avx2", "default")))
+#else
+#define LANE_LOOP
+#endif
+
+//Lane arrays never overlap, but there are too many of them for GCC to check that at runtime
+#if defined(__GNUC__) && !defined(__clang__)
+#define LANE_INDEPENDENT _Pragma("GCC ivdep")
+#else
+#define LANE_INDEPENDENT
+#endif
+
+//Lanes are padded to a whole 256 bit vector of bytes
+#define LANE_ALIGN 32
+#define NO_PC 0xFFFF
+
+//Instructions that don't run across lanes run on one lane's machine instead, through the same
+//handlers the interpreter uses. One table per quirk profile, built like interpreter.h does.
+typedef void (*laneHandler)(chipCPU *, struct instr);
+#define OP_FUNC(pattern, description) PROFILED(op_##pattern),
+#define LANE_HANDLERS static const laneHandler PROFILED(laneFuncs)[OP_COUNT] = { OPCODE_LIST(OP_FUNC) };
+
+#define QUIRK_PROFILE quirksLegacy
+#include "ops.h"
+LANE_HANDLERS
+#undef QUIRK_PROFILE
+#define QUIRK_PROFILE quirksVIP
+#include "ops.h"
+LANE_HANDLERS
+#undef QUIRK_PROFILE
+#define QUIRK_PROFILE quirksCHIP48
+#include "ops.h"
+LANE_HANDLERS
+#undef QUIRK_PROFILE
+#define QUIRK_PROFILE quirksSCHIP
+#include "ops.h"
+LANE_HANDLERS
+#undef QUIRK_PROFILE
+#define QUIRK_PROFILE quirksModern
+#include "ops.h"
+LANE_HANDLERS
+#undef QUIRK_PROFILE
+
+#undef LANE_HANDLERS
+#undef OP_FUNC
+
+#define PROFILE_HANDLERS(profile) [profile] = laneFuncs_##profile,
+static const laneHandler *const laneHandlers[quirkProfileCount] = {
+	PROFILE_HANDLERS(quirksLegacy)
+	PROFILE_HANDLERS(quirksVIP)
+	PROFILE_HANDLERS(quirksCHIP48)
+	PROFILE_HANDLERS(quirksSCHIP)
+	PROFILE_HANDLERS(quirksModern)
+};
+#undef PROFILE_HANDLERS
+
+struct lockstep {
+	int lanes; //Allocated, a multiple of LANE_ALIGN
+	int count; //In use, the rest never run
+	int cyclesPerFrame;
+	//Checked once per step rather than built in, a step is spread over every lane anyway
+	enum quirkProfile profile;
+	const struct quirks *quirks;
+	//Frames run so far. Every lane still running started this one on cycle frame * cyclesPerFrame.
+	unsigned long long frame;
+	
+	//One entry per lane, registers and stack are [register][lane]
+	byte *V;
+	uint16_t *I;
+	uint16_t *pc;
+	uint16_t *sp;
+	uint16_t *stack;
+	byte *delay;
+	byte *sound;
+	byte *ticked; //Timers have counted down for this frame
+	uint64_t *cycles; //Up to the start of this frame, budget tells how far into it a lane is
+	uint32_t *sideEffects; //Same as chipCPU's, for the idle detector
+	uint32_t *keys; //32 bits, so testing one is a shift AVX2 has per lane
+	byte *running;
+	int16_t *budget; //Instructions left this frame
+	byte *mask;		 //0xFF for lanes running the current step
+	int *active;	 //Indexes of those lanes, for the ones that go lane by lane
+	int activeCount;
+	
+	//Registers each lane had the last time it jumped back, see lanes_idle_filter()
+	uint16_t *idlePc;
+	byte *idleV;
+	uint16_t *idleI;
+	uint16_t *idleSp;
+	uint32_t *idleSideEffects;
+	byte *idleSame;
+	
+	//A whole machine per lane for everything programs index arbitrarily (memory, display),
+	//the RNG and the idle detector. Instructions run on it lane by lane, see lane_load().
+	chipCPU *cpus;
+	
+	//Bit per address some lane has written to. Code there may differ between lanes.
+	uint64_t written[MEMORY_SIZE / 64];
+	
+	unsigned long long steps;
+	unsigned long long laneSteps;
+	unsigned long long scalarSteps;
+	
+	void *block; //Every array above is carved out of this
+};
+
+static inline void mark_written(struct lockstep *ls, unsigned int addr, unsigned int length) {
+	for (unsigned int a = addr; a < addr + length && a < MEMORY_SIZE; ++a) {
+		ls->written[a >> 6] |= 1ULL << (a & 63);
+	}
+}
+
+static inline bool is_written(const struct lockstep *ls, unsigned int addr) {
+	return ls->written[addr >> 6] >> (addr & 63) & 1;
+}
+
+static inline uint64_t lane_cycles(const struct lockstep *ls, int l) {
+	return ls->cycles[l] + (ls->running[l] ? ls->cyclesPerFrame - ls->budget[l] : 0);
+}
+
+//Same as cpu_update_timers() in cycle mode. Every lane starts a frame on a multiple of
+//cyclesPerFrame, so timers count down once a frame, on its last instruction or after it.
+static void update_timers(struct lockstep *ls, int l) {
+	if (ls->budget[l] > 0 || ls->ticked[l]) return;
+	ls->ticked[l] = 1;
+	ls->delay[l] -= ls->delay[l] > 0;
+	ls->sound[l] -= ls->sound[l] > 0;
+}
+
+//Where lane l is in the frame, as cycles and a timer tick on its machine. That's what the timers
+//and the idle detector would see on a separate machine. Side effects and keys go along too.
+static chipCPU *lane_load_clock(struct lockstep *ls, int l) {
+	chipCPU *cpu = &ls->cpus[l];
+	cpu->delay_timer = ls->delay[l];
+	cpu->sound_timer = ls->sound[l];
+	cpu->timerTick = ls->frame + ls->ticked[l];
+	cpu->cycleLimit = (ls->frame + 1) * ls->cyclesPerFrame;
+	cpu->cycles = cpu->cycleLimit - ls->budget[l];
+	cpu->sideEffects = ls->sideEffects[l];
+	cpu->keys = ls->keys[l];
+	return cpu;
+}
+
+//And back. The idle detector may have moved cycles ahead, which comes off the lane's budget.
+static void lane_store_clock(struct lockstep *ls, int l) {
+	chipCPU *cpu = &ls->cpus[l];
+	ls->delay[l] = cpu->delay_timer;
+	ls->sound[l] = cpu->sound_timer;
+	ls->ticked[l] = cpu->timerTick != ls->frame;
+	ls->budget[l] = (int16_t)(cpu->cycleLimit - cpu->cycles);
+	ls->sideEffects[l] = cpu->sideEffects;
+}
+
+//Copy all of lane l into its machine, so any handler in ops.h can run on it
+static chipCPU *lane_load(struct lockstep *ls, int l) {
+	int n = ls->lanes;
+	chipCPU *cpu = lane_load_clock(ls, l);
+	for (int r = 0; r < 16; ++r) cpu->V[r] = ls->V[r * n + l];
+	for (int s = 0; s < 16; ++s) cpu->stack[s] = ls->stack[s * n + l];
+	cpu->I = ls->I[l];
+	cpu->progCounter = ls->pc[l];
+	cpu->stackPointer = ls->sp[l];
+	return cpu;
+}
+
+static void lane_store(struct lockstep *ls, int l) {
+	int n = ls->lanes;
+	chipCPU *cpu = &ls->cpus[l];
+	lane_store_clock(ls, l);
+	for (int r = 0; r < 16; ++r) ls->V[r * n + l] = cpu->V[r];
+	for (int s = 0; s < 16; ++s) ls->stack[s * n + l] = cpu->stack[s];
+	ls->I[l] = cpu->I;
+	ls->pc[l] = cpu->progCounter;
+	ls->sp[l] = cpu->stackPointer;
+	if (!cpu->running) {
+		ls->cycles[l] = cpu->cycles;
+		ls->running[l] = 0;
+		ls->budget[l] = 0;
+	}
+}
+
+//One instruction on lane l's machine. in has to be the instruction at its PC.
+static void lane_run(struct lockstep *ls, int l, chipCPU *cpu, struct instr in) {
+	unsigned int I = cpu->I;
+	cpu->currentOP = in.op;
+	laneHandlers[ls->profile][in.handler](cpu, in);
+	//Code written over here may not match the other lanes anymore
+	if (in.handler == OP_FX33) mark_written(ls, I, 3);
+	if (in.handler == OP_FX55) mark_written(ls, I, in.x + 1);
+	lane_store(ls, l);
+}
+
+//Lowest PC of the lanes with instructions left this frame
+LANE_LOOP static uint16_t lanes_min_pc(const uint16_t *pc, const int16_t *budget, int n) {
+	uint16_t lowest = NO_PC;
+	for (int i = 0; i < n; ++i) {
+		//Lanes out of budget read as NO_PC, without a branch
+		uint16_t p = pc[i] | (uint16_t)-(budget[i] <= 0);
+		lowest = p < lowest ? p : lowest;
+	}
+	return lowest;
+}
+
+//Pick the lanes at pc with instructions left, and charge each one instruction. Returns how many.
+//Everything here is 16 bits wide, so a 256 bit vector covers 16 lanes.
+LANE_LOOP static int lanes_select(byte *mask, const uint16_t *pcs, int16_t *budget, uint16_t pc, int n) {
+	uint16_t count = 0;
+	n = n / LANE_ALIGN * LANE_ALIGN;
+	LANE_INDEPENDENT
+	for (int i = 0; i < n; ++i) {
+		uint16_t m = (budget[i] > 0) & (pcs[i] == pc);
+		mask[i] = -m;
+		budget[i] -= m;
+		count += m;
+	}
+	return count;
+}
+
+//Register ops, X and Y are never F for the ones that set VF
+LANE_LOOP static void lanes_alu(byte *vx, const byte *vy, byte *vf, const byte *mask, enum opHandler handler, byte nn, const struct quirks *quirks, int n) {
+	//Shifts read VY instead with shiftUsesVY
+	const byte *source = quirks->shiftUsesVY ? vy : vx;
+	switch (handler) {
+		case OP_6XNN: for (int i = 0; i < n; ++i) vx[i] = mask[i] ? nn : vx[i]; break;
+		case OP_7XNN: for (int i = 0; i < n; ++i) vx[i] += nn & mask[i]; break;
+		//VX and VY may be the same register, which keeps GCC from turning ?: into a blend here
+		case OP_8XY0: for (int i = 0; i < n; ++i) vx[i] = (vy[i] & mask[i]) | (vx[i] & ~mask[i]); break;
+		case OP_8XY1: for (int i = 0; i < n; ++i) vx[i] |= vy[i] & mask[i]; break;
+		case OP_8XY2: for (int i = 0; i < n; ++i) vx[i] &= vy[i] | ~mask[i]; break;
+		case OP_8XY3: for (int i = 0; i < n; ++i) vx[i] ^= vy[i] & mask[i]; break;
+		case OP_8XY4:
+			for (int i = 0; i < n; ++i) {
+				byte a = vx[i], b = vy[i];
+				vf[i] = mask[i] ? b > (byte)(0xFF - a) : vf[i];
+				vx[i] = mask[i] ? (byte)(a + b) : a;
+			}
+			break;
+		case OP_8XY5:
+			for (int i = 0; i < n; ++i) {
+				byte a = vx[i], b = vy[i];
+				vf[i] = mask[i] ? b <= a : vf[i];
+				vx[i] = mask[i] ? (byte)(a - b) : a;
+			}
+			break;
+		case OP_8XY6:
+			for (int i = 0; i < n; ++i) {
+				byte a = source[i];
+				vf[i] = mask[i] ? a & 0x1 : vf[i];
+				vx[i] = mask[i] ? a >> 1 : vx[i];
+			}
+			break;
+		case OP_8XY7:
+			for (int i = 0; i < n; ++i) {
+				byte a = vx[i], b = vy[i];
+				vf[i] = mask[i] ? a <= b : vf[i];
+				vx[i] = mask[i] ? (byte)(b - a) : a;
+			}
+			break;
+		case OP_8XYE:
+			for (int i = 0; i < n; ++i) {
+				byte a = source[i];
+				vf[i] = mask[i] ? a >> 7 : vf[i];
+				vx[i] = mask[i] ? (byte)(a << 1) : vx[i];
+			}
+			break;
+		default:
+			break;
+	}
+	if (quirks->logicResetsVF && (handler == OP_8XY1 || handler == OP_8XY2 || handler == OP_8XY3)) {
+		for (int i = 0; i < n; ++i) vf[i] &= ~mask[i];
+	}
+}
+
+LANE_LOOP static void lanes_advance(uint16_t *pc, const byte *mask, int n) {
+	for (int i = 0; i < n; ++i) pc[i] += mask[i] & 2;
+}
+
+LANE_LOOP static void lanes_jump(uint16_t *pc, const byte *mask, uint16_t target, int n) {
+	for (int i = 0; i < n; ++i) pc[i] = mask[i] ? target : pc[i];
+}
+
+LANE_LOOP static void lanes_skip(uint16_t *pc, const byte *vx, const byte *vy, const uint32_t *keys, const byte *mask, enum opHandler handler, byte nn, int n) {
+	switch (handler) {
+		case OP_3XNN: for (int i = 0; i < n; ++i) pc[i] += mask[i] & (vx[i] == nn ? 4 : 2); break;
+		case OP_4XNN: for (int i = 0; i < n; ++i) pc[i] += mask[i] & (vx[i] != nn ? 4 : 2); break;
+		case OP_5XY0: for (int i = 0; i < n; ++i) pc[i] += mask[i] & (vx[i] == vy[i] ? 4 : 2); break;
+		case OP_9XY0: for (int i = 0; i < n; ++i) pc[i] += mask[i] & (vx[i] != vy[i] ? 4 : 2); break;
+		case OP_EX9E:
+			for (int i = 0; i < n; ++i) {
+				uint32_t key = vx[i];
+				uint32_t pressed = (key < 16) & (keys[i] >> (key & 31));
+				pc[i] += mask[i] & (pressed ? 4 : 2);
+			}
+			break;
+		case OP_EXA1:
+			for (int i = 0; i < n; ++i) {
+				uint32_t key = vx[i];
+				uint32_t pressed = (key < 16) & (keys[i] >> (key & 31));
+				pc[i] += mask[i] & (pressed ? 2 : 4);
+			}
+			break;
+		default: break;
+	}
+}
+
+//FX07, FX15 and FX18, counting the timers down first where a frame's tick is due
+LANE_LOOP static void lanes_timers(byte *vx, byte *delay, byte *sound, byte *ticked, uint32_t *sideEffects, const int16_t *budget, const byte *mask, enum opHandler handler, int n) {
+	for (int i = 0; i < n; ++i) {
+		byte tick = mask[i] & (budget[i] <= 0) & ~ticked[i] & 1;
+		ticked[i] |= tick;
+		delay[i] -= tick & (delay[i] > 0);
+		sound[i] -= tick & (sound[i] > 0);
+	}
+	switch (handler) {
+		case OP_FX07: for (int i = 0; i < n; ++i) vx[i] = (delay[i] & mask[i]) | (vx[i] & ~mask[i]); break;
+		case OP_FX15: for (int i = 0; i < n; ++i) delay[i] = (vx[i] & mask[i]) | (delay[i] & ~mask[i]); break;
+		case OP_FX18: for (int i = 0; i < n; ++i) sound[i] = (vx[i] & mask[i]) | (sound[i] & ~mask[i]); break;
+		default: break;
+	}
+	if (handler != OP_FX07) {
+		for (int i = 0; i < n; ++i) sideEffects[i] += mask[i] & 1;
+	}
+}
+
+//ANNN, FX1E (X isn't F) and FX29
+LANE_LOOP static void lanes_index(uint16_t *I, const byte *vx, byte *vf, const byte *mask, enum opHandler handler, uint16_t nnn, int n) {
+	switch (handler) {
+		case OP_ANNN: for (int i = 0; i < n; ++i) I[i] = mask[i] ? nnn : I[i]; break;
+		case OP_FX1E:
+			for (int i = 0; i < n; ++i) {
+				uint32_t sum = I[i] + vx[i];
+				vf[i] = mask[i] ? sum > 0xFFF : vf[i];
+				I[i] = mask[i] ? (uint16_t)sum : I[i];
+			}
+			break;
+		case OP_FX29:
+			for (int i = 0; i < n; ++i) {
+				uint16_t wide = -(mask[i] & 1);
+				I[i] = (vx[i] * 0x5 & wide) | (I[i] & ~wide);
+			}
+			break;
+		default: break;
+	}
+}
+
+//List the lanes in the step for the instructions that go lane by lane. Without a branch, as which
+//lanes are in a step is anybody's guess.
+static void lanes_list_active(struct lockstep *ls) {
+	int count = 0;
+	for (int i = 0; i < ls->lanes; ++i) {
+		ls->active[count] = i;
+		count += ls->mask[i] & 1;
+	}
+	ls->activeCount = count;
+}
+
+//2NNN and 00EE. Returns false without doing anything if some lane's stack would overflow or
+//underflow, those go through ops.h lane by lane like any other oddity.
+static bool lanes_call(struct lockstep *ls, struct instr in) {
+	int n = ls->lanes;
+	bool call = in.handler == OP_2NNN;
+	for (int a = 0; a < ls->activeCount; ++a) {
+		unsigned int sp = ls->sp[ls->active[a]];
+		if (call ? sp >= 16 : sp - 1 >= 16) return false;
+	}
+	for (int a = 0; a < ls->activeCount; ++a) {
+		int i = ls->active[a];
+		if (call) {
+			ls->stack[ls->sp[i]++ * n + i] = ls->pc[i] + 2;
+			ls->pc[i] = in.nnn;
+		} else {
+			ls->pc[i] = ls->stack[--ls->sp[i] * n + i];
+		}
+	}
+	return true;
+}
+
+//DXYN and CXNN run on each lane's machine, but only need a register or two of its state.
+//Copying just those over is a lot cheaper than the whole lane_load() and lane_store().
+static void lanes_draw(struct lockstep *ls, struct instr in) {
+	int n = ls->lanes;
+	laneHandler draw = laneHandlers[ls->profile][OP_DXYN];
+	for (int a = 0; a < ls->activeCount; ++a) {
+		int i = ls->active[a];
+		chipCPU *cpu = &ls->cpus[i];
+		cpu->V[in.x] = ls->V[in.x * n + i];
+		cpu->V[in.y] = ls->V[in.y * n + i];
+		cpu->I = ls->I[i];
+		cpu->sideEffects = ls->sideEffects[i];
+		draw(cpu, in);
+		ls->V[0xF * n + i] = cpu->V[0xF];
+		ls->sideEffects[i] = cpu->sideEffects;
+	}
+}
+
+//FX33, FX55 and FX65, copying only the registers they use
+static void lanes_memory(struct lockstep *ls, struct instr in) {
+	int n = ls->lanes;
+	laneHandler handler = laneHandlers[ls->profile][in.handler];
+	int count = in.handler == OP_FX33 ? 1 : in.x + 1;
+	int first = in.handler == OP_FX33 ? in.x : 0;
+	for (int a = 0; a < ls->activeCount; ++a) {
+		int i = ls->active[a];
+		chipCPU *cpu = &ls->cpus[i];
+		uint16_t I = ls->I[i];
+		cpu->I = I;
+		if (in.handler == OP_FX65) {
+			handler(cpu, in);
+			for (int r = 0; r < count; ++r) ls->V[r * n + i] = cpu->V[r];
+		} else {
+			for (int r = first; r < first + count; ++r) cpu->V[r] = ls->V[r * n + i];
+			cpu->sideEffects = ls->sideEffects[i];
+			handler(cpu, in);
+			ls->sideEffects[i] = cpu->sideEffects;
+			//Code written over here may not match the other lanes anymore
+			mark_written(ls, I, in.handler == OP_FX33 ? 3 : count);
+		}
+		ls->I[i] = cpu->I;
+	}
+}
+
+static void lanes_random(struct lockstep *ls, struct instr in) {
+	int n = ls->lanes;
+	laneHandler random = laneHandlers[ls->profile][OP_CXNN];
+	for (int a = 0; a < ls->activeCount; ++a) {
+		int i = ls->active[a];
+		chipCPU *cpu = &ls->cpus[i];
+		random(cpu, in);
+		ls->V[in.x * n + i] = cpu->V[in.x];
+	}
+}
+
+//The idle detector's first look, across lanes. Lanes with instructions left this frame whose registers
+//are what they were the last time they jumped back from pc are marked in idleSame, the rest note them
+//down for next time. Only marked lanes can be idling, so only they go on to cpu_idle_jump(), which
+//checks the rest and keeps its own snapshot.
+LANE_LOOP static void lanes_idle_filter(struct lockstep *ls, uint16_t pc) {
+	int n = ls->lanes / LANE_ALIGN * LANE_ALIGN;
+	const byte *mask = ls->mask;
+	byte *same = ls->idleSame;
+	const uint16_t *I = ls->I, *sp = ls->sp;
+	const uint32_t *sideEffects = ls->sideEffects;
+	const int16_t *budget = ls->budget;
+	uint16_t *idlePc = ls->idlePc, *idleI = ls->idleI, *idleSp = ls->idleSp;
+	uint32_t *idleSideEffects = ls->idleSideEffects;
+	LANE_INDEPENDENT
+	for (int i = 0; i < n; ++i) {
+		bool match = (idlePc[i] == pc) & (idleI[i] == I[i]) & (idleSp[i] == sp[i]) & (idleSideEffects[i] == sideEffects[i]);
+		same[i] = mask[i] & -(match & (budget[i] > 0));
+		idlePc[i] = mask[i] ? pc : idlePc[i];
+		idleI[i] = mask[i] ? I[i] : idleI[i];
+		idleSp[i] = mask[i] ? sp[i] : idleSp[i];
+		idleSideEffects[i] = mask[i] ? sideEffects[i] : idleSideEffects[i];
+	}
+	for (int r = 0; r < 16; ++r) {
+		const byte *V = ls->V + r * n;
+		byte *idleV = ls->idleV + r * n;
+		LANE_INDEPENDENT
+		for (int i = 0; i < n; ++i) {
+			same[i] &= -(idleV[i] == V[i]);
+			idleV[i] = mask[i] ? V[i] : idleV[i];
+		}
+	}
+}
+
+//The jump at pc went backwards on every lane in the step. Any that may be idling get the idle detector
+//run on their machine, which can skip them ahead to the end of the frame or the next timer tick.
+static void lanes_idle_jump(struct lockstep *ls, uint16_t pc) {
+	lanes_idle_filter(ls, pc);
+	for (int a = 0; a < ls->activeCount; ++a) {
+		int l = ls->active[a];
+		if (!ls->idleSame[l]) continue;
+		//It only reads the registers, and only moves the clock
+		chipCPU *cpu = lane_load_clock(ls, l);
+		for (int r = 0; r < 16; ++r) cpu->V[r] = ls->V[r * ls->lanes + l];
+		cpu->I = ls->I[l];
+		cpu->stackPointer = ls->sp[l];
+		cpu_idle_jump(cpu, pc);
+		lane_store_clock(ls, l);
+	}
+}
+
+//Run the lowest PC on every lane sitting on it. Returns false once no lane has instructions left.
+static bool lockstep_step(struct lockstep *ls) {
+	int n = ls->lanes;
+	uint16_t pc = lanes_min_pc(ls->pc, ls->budget, n);
+	if (pc == NO_PC) return false;
+	int active = lanes_select(ls->mask, ls->pc, ls->budget, pc, n);
+	ls->steps++;
+	ls->laneSteps += active;
+	
+	if (pc >= MEMORY_SIZE - 1 || is_written(ls, pc) || is_written(ls, pc + 1)) {
+		//The code here may have been rewritten in some lanes, every lane decodes its own
+		ls->scalarSteps++;
+		lanes_list_active(ls);
+		for (int a = 0; a < ls->activeCount; ++a) {
+			int l = ls->active[a];
+			chipCPU *cpu = lane_load(ls, l);
+			lane_run(ls, l, cpu, cpu_decode(cpu->memory[pc] << 8 | cpu->memory[pc + 1]));
+		}
+		return true;
+	}
+	
+	//Nobody wrote here, so every lane still has the same bytes as lane 0
+	const byte *code = ls->cpus[0].memory;
+	struct instr in = cpu_decode(code[pc] << 8 | code[pc + 1]);
+	byte *vx = ls->V + in.x * n;
+	byte *vy = ls->V + in.y * n;
+	byte *vf = ls->V + 0xF * n;
+	bool touchesVF = in.x == 0xF || in.y == 0xF;
+	switch (in.handler) {
+		case OP_1NNN:
+			//Halting on a jump to itself is up to op_1NNN()
+			if (AUTOHALT && in.nnn == pc) break;
+			lanes_jump(ls->pc, ls->mask, in.nnn, n);
+			if (in.nnn <= pc) {
+				lanes_list_active(ls);
+				lanes_idle_jump(ls, pc);
+			}
+			return true;
+		case OP_2NNN:
+		case OP_00EE:
+			lanes_list_active(ls);
+			if (!lanes_call(ls, in)) break;
+			return true;
+		case OP_3XNN:
+		case OP_4XNN:
+		case OP_5XY0:
+		case OP_9XY0:
+		case OP_EX9E:
+		case OP_EXA1:
+			lanes_skip(ls->pc, vx, vy, ls->keys, ls->mask, in.handler, in.nn, n);
+			return true;
+		case OP_DXYN:
+			lanes_list_active(ls);
+			lanes_draw(ls, in);
+			lanes_advance(ls->pc, ls->mask, n);
+			return true;
+		case OP_CXNN:
+			lanes_list_active(ls);
+			lanes_random(ls, in);
+			lanes_advance(ls->pc, ls->mask, n);
+			return true;
+		case OP_FX33:
+		case OP_FX55:
+		case OP_FX65:
+			lanes_list_active(ls);
+			lanes_memory(ls, in);
+			lanes_advance(ls->pc, ls->mask, n);
+			return true;
+		case OP_FX07:
+		case OP_FX15:
+		case OP_FX18:
+			lanes_timers(vx, ls->delay, ls->sound, ls->ticked, ls->sideEffects, ls->budget, ls->mask, in.handler, n);
+			lanes_advance(ls->pc, ls->mask, n);
+			return true;
+		case OP_8XY4:
+		case OP_8XY5:
+		case OP_8XY6:
+		case OP_8XY7:
+		case OP_8XYE:
+			//These write VF before VX, the lane by lane path keeps that order right
+			if (touchesVF) break;
+			//Fall through
+		case OP_6XNN:
+		case OP_7XNN:
+		case OP_8XY0:
+		case OP_8XY1:
+		case OP_8XY2:
+		case OP_8XY3:
+			lanes_alu(vx, vy, vf, ls->mask, in.handler, in.nn, ls->quirks, n);
+			lanes_advance(ls->pc, ls->mask, n);
+			return true;
+		case OP_FX1E:
+			if (in.x == 0xF) break;
+			//Fall through
+		case OP_ANNN:
+		case OP_FX29:
+			lanes_index(ls->I, vx, vf, ls->mask, in.handler, in.nnn, n);
+			lanes_advance(ls->pc, ls->mask, n);
+			return true;
+		default:
+			break;
+	}
+	//Input waits, calls that overflow the stack and the rest run on each lane's machine
+	lanes_list_active(ls);
+	for (int a = 0; a < ls->activeCount; ++a) {
+		int l = ls->active[a];
+		lane_run(ls, l, lane_load(ls, l), in);
+	}
+	return true;
+}
+
+//Hand out aligned arrays from the single allocation
+static void *carve(byte **next, size_t bytes) {
+	void *p = *next;
+	*next += (bytes + 63) & ~(size_t)63;
+	return p;
+}
+
+static size_t layout(struct lockstep *ls, byte *base) {
+	size_t n = ls->lanes;
+	byte *next = base;
+	ls->V = carve(&next, 16 * n);
+	ls->I = carve(&next, n * sizeof(uint16_t));
+	ls->pc = carve(&next, n * sizeof(uint16_t));
+	ls->sp = carve(&next, n * sizeof(uint16_t));
+	ls->stack = carve(&next, 16 * n * sizeof(uint16_t));
+	ls->delay = carve(&next, n);
+	ls->sound = carve(&next, n);
+	ls->ticked = carve(&next, n);
+	ls->cycles = carve(&next, n * sizeof(uint64_t));
+	ls->sideEffects = carve(&next, n * sizeof(uint32_t));
+	ls->keys = carve(&next, n * sizeof(uint32_t));
+	ls->running = carve(&next, n);
+	ls->budget = carve(&next, n * sizeof(int16_t));
+	ls->mask = carve(&next, n);
+	ls->active = carve(&next, n * sizeof(int));
+	ls->idlePc = carve(&next, n * sizeof(uint16_t));
+	ls->idleV = carve(&next, 16 * n);
+	ls->idleI = carve(&next, n * sizeof(uint16_t));
+	ls->idleSp = carve(&next, n * sizeof(uint16_t));
+	ls->idleSideEffects = carve(&next, n * sizeof(uint32_t));
+	ls->idleSame = carve(&next, n);
+	return next - base;
+}
+
+struct lockstep *lockstep_create(int lanes, int cyclesPerFrame) {
+	if (lanes < 1) return NULL;
+	cpu_build_decode_table();
+	struct lockstep *ls = calloc(1, sizeof(*ls));
+	if (!ls) return NULL;
+	ls->count = lanes;
+	ls->lanes = (lanes + LANE_ALIGN - 1) / LANE_ALIGN * LANE_ALIGN;
+	ls->cyclesPerFrame = cyclesPerFrame > 0 ? cyclesPerFrame : cyclesPerFrameNormal;
+	ls->profile = quirksLegacy;
+	ls->quirks = &quirkProfiles[quirksLegacy];
+	//Budgets are 16 bit
+	if (ls->cyclesPerFrame > INT16_MAX) ls->cyclesPerFrame = INT16_MAX;
+	
+	//Sizes first, then the real thing. calloc'd memory is aligned enough for the 64 byte rounding to hold.
+	size_t bytes = layout(ls, NULL) + 64;
+	ls->block = calloc(1, bytes);
+	//Padding lanes never run, so they don't get a machine
+	ls->cpus = malloc(ls->count * sizeof(chipCPU));
+	if (!ls->block || !ls->cpus) {
+		free(ls->block);
+		free(ls->cpus);
+		free(ls);
+		return NULL;
+	}
+	layout(ls, (byte *)(((uintptr_t)ls->block + 63) & ~(uintptr_t)63));
+	
+	for (int l = 0; l < ls->count; ++l) {
+		chipCPU *cpu = &ls->cpus[l];
+		cpu_initialize(cpu);
+		cpu_set_timer_mode(cpu, timerModeCycles, ls->cyclesPerFrame);
+		cpu->quiet = true;
+		ls->pc[l] = cpu->progCounter;
+		ls->running[l] = 1;
+	}
+	return ls;
+}
+
+int lockstep_load_rom(struct lockstep *ls, const unsigned char *rom, long size) {
+	for (int l = 0; l < ls->count; ++l) {
+		if (cpu_load_rom_buffer(&ls->cpus[l], rom, size) != 0) return -2;
+	}
+	memset(ls->written, 0, sizeof(ls->written));
+	return 0;
+}
+
+void lockstep_set_quirks(struct lockstep *ls, enum quirkProfile profile) {
+	if (profile < 0 || profile >= quirkProfileCount) return;
+	ls->profile = profile;
+	ls->quirks = &quirkProfiles[profile];
+	for (int l = 0; l < ls->count; ++l) {
+		cpu_set_quirks(&ls->cpus[l], profile);
+	}
+}
+
+void lockstep_set_keys(struct lockstep *ls, int lane, uint16_t keys) {
+	//A loop that was idling may not be anymore, so it has to be seen idling again.
+	//cpu_run() can't tell and does this every run, lanes only need it when the keys change.
+	if (ls->keys[lane] != keys) ls->cpus[lane].idle.pc = IDLE_NONE;
+	ls->keys[lane] = keys;
+}
+
+void lockstep_set_seed(struct lockstep *ls, int lane, uint64_t seed, uint64_t stream) {
+	cpu_set_seed(&ls->cpus[lane], seed, stream);
+}
+
+void lockstep_run_frame(struct lockstep *ls) {
+	for (int l = 0; l < ls->lanes; ++l) {
+		ls->budget[l] = ls->running[l] ? ls->cyclesPerFrame : 0;
+	}
+	while (lockstep_step(ls));
+	for (int l = 0; l < ls->count; ++l) {
+		if (!ls->running[l]) continue;
+		update_timers(ls, l);
+		ls->cycles[l] = lane_cycles(ls, l);
+		ls->budget[l] = ls->cyclesPerFrame;
+		ls->ticked[l] = 0;
+	}
+	ls->frame++;
+}
+
+uint32_t lockstep_read_framebuffer(struct lockstep *ls, int lane, uint64_t *rows) {
+	get_current_frame(&ls->cpus[lane], rows);
+	return cpu_take_dirty_rows(&ls->cpus[lane]);
+}
+
+bool lockstep_halted(const struct lockstep *ls, int lane) {
+	return !ls->running[lane];
+}
+
+unsigned long long lockstep_cycles(const struct lockstep *ls, int lane) {
+	return ls->cycles[lane];
+}
+
+void lockstep_stats(const struct lockstep *ls, unsigned long long *steps, double *lanesPerStep, unsigned long long *scalarSteps) {
+	if (steps) *steps = ls->steps;
+	if (lanesPerStep) *lanesPerStep = ls->steps ? (double)ls->laneSteps / ls->steps : 0;
+	if (scalarSteps) *scalarSteps = ls->scalarSteps;
+}
+
+void lockstep_destroy(struct lockstep *ls) {
+	if (!ls) return;
+	for (int l = 0; l < ls->count; ++l) {
+		cpu_destroy(&ls->cpus[l]);
+	}
+	free(ls->cpus);
+	free(ls->block);
+	free(ls);
+}
@@ -0,0 +1,56 @@
+//
+//  lockstep.h
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#ifndef lockstep_h
+#define lockstep_h
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "quirks.h"
+
+//Lockstep batch interpreter, runs one ROM on many machines (lanes) at once.
+//Registers, PC, I, stack and timers are kept as one array per field with an entry per lane,
+//so lanes that sit on the same instruction run it together with vector ops across the arrays.
+//Each step runs the lowest PC any lane is at, which lets lanes that split on a branch meet again.
+//Instructions that don't fit the arrays (drawing, memory, random numbers, input waits) run on a
+//whole machine kept for each lane, through the handlers in ops.h, and so does the idle detector.
+//Every lane runs exactly the instructions a separate machine would, so results match chip8_step_frame().
+
+struct lockstep;
+
+//lanes machines, cyclesPerFrame instructions each per frame (0 for the default). NULL if out of memory.
+struct lockstep *lockstep_create(int lanes, int cyclesPerFrame);
+
+//Load the same ROM into every lane. Returns 0 on success, -2 if the ROM is too big.
+int lockstep_load_rom(struct lockstep *ls, const unsigned char *rom, long size);
+
+//Same as chip8_set_quirks(), for every lane. Lanes start out on quirksLegacy.
+void lockstep_set_quirks(struct lockstep *ls, enum quirkProfile profile);
+
+//Same as chip8_set_keys() for one lane, from the next frame on
+void lockstep_set_keys(struct lockstep *ls, int lane, uint16_t keys);
+
+//Same as chip8_set_seed() for one lane. Lanes start out on RNG_DEFAULT_SEED, stream 0.
+void lockstep_set_seed(struct lockstep *ls, int lane, uint64_t seed, uint64_t stream);
+
+//Run one frame worth of instructions on every lane that hasn't halted
+void lockstep_run_frame(struct lockstep *ls);
+
+//Same as chip8_read_framebuffer() for one lane
+uint32_t lockstep_read_framebuffer(struct lockstep *ls, int lane, uint64_t *rows);
+
+bool lockstep_halted(const struct lockstep *ls, int lane);
+unsigned long long lockstep_cycles(const struct lockstep *ls, int lane);
+
+//Steps run, and how many lanes they ran on average. Steps with code that differs between lanes
+//(the ROM rewrote it in some of them) run one lane at a time, and are counted separately.
+void lockstep_stats(const struct lockstep *ls, unsigned long long *steps, double *lanesPerStep, unsigned long long *scalarSteps);
+
+void lockstep_destroy(struct lockstep *ls);
+
+#endif /* lockstep_h */
@@ -8,65 +8,38 @@
 
 #include <SDL2/SDL.h>
 #include "CPU.h"
+#include "chip8.h"
+#include "metrics.h"
+#include "movie.h"
+#include "overlay.h"
+#include "rewind.h"
+#include "rng.h"
+#include "scheduler.h"
+#include "aot.h"
+#include "renderer.h"
+#include "tribuf.h"
+#include "timing.h"
 #include <time.h>
 
-// THREADING
-#ifdef WINDOWS
-#include <Windows.h>
-#else
-#include <pthread.h>
-#endif
+#include "thread.h"
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
 
-struct thread {
-#ifdef WINDOWS
-	HANDLE thread_handle;
-	DWORD thread_id;
-#else
-	pthread_t thread_id;
-#endif
-	int thread_num;
-	bool threadComplete;
-	void *(*threadFunc)(void *);
-};
-
-// Multiplatform thread stub
-#ifdef WINDOWS
-DWORD WINAPI threadStub(LPVOID arg) {
-#else
-	void *threadStub(void *arg) {
-#endif
-		return ((struct thread*)arg)->threadFunc(arg);
-	}
-	
-	void checkThread(struct thread *t) {
-#ifdef WINDOWS
-		WaitForSingleObjectEx(t->thread_handle, INFINITE, FALSE);
-#else
-		if (pthread_join(t->thread_id, NULL)) {
-			printf("Thread %i frozen.", t->thread_num);
-		}
-#endif
-	}
-	
-	int startThread(struct thread *t) {
-#ifdef WINDOWS
-		t->thread_handle = CreateThread(NULL, 0, threadStub, t, 0, &t->thread_id);
-		if (t->thread_handle == NULL) return -1;
-		return 0;
-#else
-		pthread_attr_t attribs;
-		pthread_attr_init(&attribs);
-		pthread_attr_setdetachstate(&attribs, PTHREAD_CREATE_JOINABLE);
-		int ret = pthread_create(&t->thread_id, &attribs, threadStub, t);
-		pthread_attr_destroy(&attribs);
-		return ret;
-#endif
-}
-
-bool emulatorRunning = true;
+atomic_bool emulatorRunning = true;
+//Pressed keys, one bit per CHIP-8 key. Written by input_watcher(), read by the emulation thread.
+_Atomic uint16_t keyMask = 0;
+//When a key last changed, if the emulation thread hasn't picked the change up yet, 0 otherwise.
+//Only the oldest change waiting is kept, that's the one whose latency counts.
+atomic_llong keyChangedAt = 0;
+//Backspace held, the emulation thread steps back through the rewind buffer instead of running
+atomic_bool rewindHeld = false;
+//F9 pressed, the emulation thread starts or stops the trace before its next frame
+atomic_bool traceToggled = false;
+//F3 pressed, the render thread shows or hides the metrics overlay
+atomic_bool overlayToggled = false;
 
 void (*signal(int signo, void (*func )(int)))(int);
 typedef void sigfunc(int);
@@ -96,40 +69,6 @@ void destroy_texture(SDL_Texture *texture) {
 	}
 }
 
-void render(SDL_Renderer *renderer) {
-	//Clear the window
-	SDL_SetRenderDrawColor(renderer, 0x0, 0x0, 0x0, 0x0);
-	SDL_RenderClear(renderer);
-	
-	//Render the data
-	char data[2048] = {0};
-	get_current_frame(data, 2048);
-	SDL_SetRenderDrawColor(renderer, 255, 255, 255, 0);
-	for (int y = 0; y < 32; ++y) {
-		for (int x = 0; x < 64; ++x) {
-			if (data[(y*64) + x] == 0) {
-				//Don't draw ¯\_(ツ)_/¯
-			} else {
-				SDL_RenderDrawPoint(renderer, x, y);
-			}
-		}
-	}
-	SDL_RenderPresent(renderer);
-}
-
-void sleepMSec(int ms) {
-#ifdef WINDOWS
-	Sleep(ms);
-#elif __APPLE__
-	struct timespec ts;
-	ts.tv_sec = ms / 1000;
-	ts.tv_nsec = (ms % 1000) * 1000000;
-	nanosleep(&ts, NULL);
-#elif __linux__
-	usleep(ms * 1000);
-#endif
-}
-
 /*
  KEYMAPPING
  CHIP8 HEX MAP
@@ -155,84 +94,265 @@ void sleepMSec(int ms) {
  
  */
 
-void set_input() {
-	//Get keyboard input, then send that to the CPU
-	
-	SDL_PumpEvents();
-	const Uint8 *keys = SDL_GetKeyboardState(NULL);
-	byte input[16] = {0x0};
-	
-	//Prevent keys from sticking when pressing more than one at a time
-	cpu_set_keys(input);
-	
-	if (keys[SDL_SCANCODE_1]) {
-		input[0x1] = 0x1;
-	}
-	if (keys[SDL_SCANCODE_2]) {
-		input[0x2] = 0x1;
-	}
-	if (keys[SDL_SCANCODE_3]) {
-		input[0x3] = 0x1;
-	}
-	if (keys[SDL_SCANCODE_4]) {
-		input[0xC] = 0x1;
-	}
-	if (keys[SDL_SCANCODE_Q]) {
-		input[0x4] = 0x1;
-	}
-	if (keys[SDL_SCANCODE_W]) {
-		input[0x5] = 0x1;
-	}
-	if (keys[SDL_SCANCODE_E]) {
-		input[0x6] = 0x1;
-	}
-	if (keys[SDL_SCANCODE_R]) {
-		input[0xD] = 0x1;
+//CHIP-8 key for a host key, -1 if it isn't mapped
+static int key_for_scancode(SDL_Scancode code) {
+	switch (code) {
+		case SDL_SCANCODE_1: return 0x1;
+		case SDL_SCANCODE_2: return 0x2;
+		case SDL_SCANCODE_3: return 0x3;
+		case SDL_SCANCODE_4: return 0xC;
+		case SDL_SCANCODE_Q: return 0x4;
+		case SDL_SCANCODE_W: return 0x5;
+		case SDL_SCANCODE_E: return 0x6;
+		case SDL_SCANCODE_R: return 0xD;
+		case SDL_SCANCODE_A: return 0x7;
+		case SDL_SCANCODE_S: return 0x8;
+		case SDL_SCANCODE_D: return 0x9;
+		case SDL_SCANCODE_F: return 0xE;
+		case SDL_SCANCODE_Z: return 0xA;
+		case SDL_SCANCODE_X: return 0x0;
+		case SDL_SCANCODE_C: return 0xB;
+		case SDL_SCANCODE_V: return 0xF;
+		default: return -1;
 	}
-	if (keys[SDL_SCANCODE_A]) {
-		input[0x7] = 0x1;
-	}
-	if (keys[SDL_SCANCODE_S]) {
-		input[0x8] = 0x1;
-	}
-	if (keys[SDL_SCANCODE_D]) {
-		input[0x9] = 0x1;
-	}
-	if (keys[SDL_SCANCODE_F]) {
-		input[0xE] = 0x1;
-	}
-	if (keys[SDL_SCANCODE_Z]) {
-		input[0xA] = 0x1;
-	}
-	if (keys[SDL_SCANCODE_X]) {
-		input[0x0] = 0x1;
-	}
-	if (keys[SDL_SCANCODE_C]) {
-		input[0xB] = 0x1;
+}
+
+//Event watcher, SDL calls this as events arrive instead of us polling the keyboard.
+//Key presses and releases flip bits in keyMask, which the emulation thread reads once a frame.
+//SDL sends releases for held keys when the window loses focus, so keys don't get stuck.
+int input_watcher(void *userData, SDL_Event *event) {
+	(void)userData;
+	switch (event->type) {
+		case SDL_QUIT:
+			emulatorRunning = false;
+			break;
+		case SDL_KEYDOWN:
+		case SDL_KEYUP: {
+			if (event->key.keysym.scancode == SDL_SCANCODE_BACKSPACE) {
+				atomic_store_explicit(&rewindHeld, event->type == SDL_KEYDOWN, memory_order_relaxed);
+				break;
+			}
+			if (event->key.keysym.scancode == SDL_SCANCODE_F9) {
+				if (event->type == SDL_KEYDOWN && !event->key.repeat) {
+					atomic_store_explicit(&traceToggled, true, memory_order_relaxed);
+				}
+				break;
+			}
+			if (event->key.keysym.scancode == SDL_SCANCODE_F3) {
+				if (event->type == SDL_KEYDOWN && !event->key.repeat) {
+					atomic_store_explicit(&overlayToggled, true, memory_order_relaxed);
+				}
+				break;
+			}
+			int key = key_for_scancode(event->key.keysym.scancode);
+			if (key < 0) break;
+			uint16_t bit = 1 << key;
+			bool down = event->type == SDL_KEYDOWN;
+			uint16_t old;
+			if (down) {
+				old = atomic_fetch_or_explicit(&keyMask, bit, memory_order_relaxed);
+			} else {
+				old = atomic_fetch_and_explicit(&keyMask, ~bit, memory_order_relaxed);
+			}
+			//Held keys repeat, only time actual changes
+			if (((old & bit) != 0) != down) {
+				long long none = 0;
+				atomic_compare_exchange_strong_explicit(&keyChangedAt, &none, time_now_ns(), memory_order_release, memory_order_relaxed);
+			}
+			break;
+		}
+		default:
+			break;
 	}
-	if (keys[SDL_SCANCODE_V]) {
-		input[0xF] = 0x1;
+	return 1;
+}
+
+//Hands a key change the ROM has read over to the render thread, which times it to the next present.
+//The emulation thread fills it in while keyTime is 0, the render thread zeroes keyTime once it's done.
+struct latencyProbe {
+	atomic_llong keyTime; //When the key changed
+	long long readTime; //End of the frame the ROM first looked at the keys in after that
+	unsigned long long frame; //Emulation frame the read was in, see framesRun
+};
+
+struct emulation {
+	struct chip8 *machine;
+	struct scheduler sched;
+	struct tribuf frames;
+	//NULL unless --rewind was given
+	struct rewind_buffer *history;
+	//NULL unless --record was given
+	struct movie *movie;
+	//NULL unless --trace was given
+	char *tracePath;
+	bool tracing;
+	//Oldest key change the ROM hasn't looked at yet, 0 if none
+	long long keyChanged;
+	struct latencyProbe latency;
+	//Emulation frames finished, counted whether they drew anything or not.
+	//Bumped after the frame's display is published, so any frame acquired after reading it is at least as new.
+	atomic_ullong framesRun;
+};
+
+//Start the trace, or finish it. Starting again writes over the last one.
+void toggle_trace(struct emulation *emu) {
+	if (emu->tracing) {
+		long long traced = chip8_trace_stop(emu->machine);
+		if (traced < 0) {
+			printf("Couldn't write the trace %s\n", emu->tracePath);
+		} else {
+			printf("Traced %lld instructions to %s\n", traced, emu->tracePath);
+		}
+		emu->tracing = false;
+	} else {
+		emu->tracing = chip8_trace_start(emu->machine, emu->tracePath);
+		printf(emu->tracing ? "Tracing to %s\n" : "Couldn't start the trace %s\n", emu->tracePath);
 	}
-	
-	cpu_set_keys(input);
 }
 
-void *decrement_counters(void *none) {
+//Runs the CPU at its own pace, and hands finished frames to the render thread
+void *emulation_thread(void *arg) {
+	struct thread *t = (struct thread *)arg;
+	struct emulation *emu = (struct emulation *)t->userData;
+	
 	while (emulatorRunning) {
-		cpu_decrement_counters();
-		sleepMSec(16);
+		if (emu->tracePath && atomic_exchange_explicit(&traceToggled, false, memory_order_relaxed)) {
+			toggle_trace(emu);
+		}
+		if (emu->history && atomic_load_explicit(&rewindHeld, memory_order_relaxed)) {
+			//Go back a frame instead of running one, and stay on the oldest once the history runs out
+			rewind_step_back(emu->history, emu->machine);
+		} else {
+			if (emu->history) rewind_record(emu->history, emu->machine);
+			//Pick up the latest key state from the render thread. The change time is taken first,
+			//so the keys are at least as new as it.
+			long long changed = atomic_exchange_explicit(&keyChangedAt, 0, memory_order_acquire);
+			if (changed && !emu->keyChanged) emu->keyChanged = changed;
+			uint16_t keys = atomic_load_explicit(&keyMask, memory_order_relaxed);
+			chip8_set_keys(emu->machine, keys);
+			if (emu->movie && !movie_record_frame(emu->movie, keys)) {
+				printf("Out of memory for the movie, recording stops here\n");
+				emu->movie = NULL;
+			}
+			//Run this frame's batch of CPU cycles, stop if the CPU halted
+			if (!scheduler_run_frame(&emu->sched, emu->machine)) {
+				emulatorRunning = false;
+			}
+			//Once the ROM has looked at the keys since the change, the render thread takes it from here.
+			//If it's still busy with the last one, this one goes unmeasured.
+			bool keysRead = chip8_take_keys_read(emu->machine);
+			if (emu->keyChanged && keysRead) {
+				if (!atomic_load_explicit(&emu->latency.keyTime, memory_order_acquire)) {
+					emu->latency.readTime = time_now_ns();
+					emu->latency.frame = atomic_load_explicit(&emu->framesRun, memory_order_relaxed) + 1;
+					atomic_store_explicit(&emu->latency.keyTime, emu->keyChanged, memory_order_release);
+				}
+				emu->keyChanged = 0;
+			}
+		}
+		//Publish the display if anything was drawn, the render thread picks up the latest one
+		if (chip8_read_framebuffer(emu->machine, tribuf_back(&emu->frames)->rows)) {
+			tribuf_publish(&emu->frames);
+		}
+		atomic_fetch_add_explicit(&emu->framesRun, 1, memory_order_release);
+		//Sleep to the next frame deadline
+		scheduler_wait(&emu->sched);
 	}
+	
+	t->threadComplete = true;
 	return NULL;
 }
 
+void print_usage(char *name) {
+	printf("Usage: %s [--ipf <instructions per frame>] [--uncapped] [--wallclock-timers] [--jit] [--quirks <profile>] [--seed <n>] [--state <file>] [--rewind <MB>] [--record <movie>] [--trace <file>] [--profile <stacks file>] [--overlay] [--stats <file>] [--stats-socket <path>] <ROM>\n", name);
+	printf("--record saves the keys of every frame, for chip8-headless --replay to run again exactly.\n");
+	printf("--trace writes every instruction run to a file for chip8-trace, F9 stops it and starts it over.\n");
+	printf("--profile prints where the cycles went at exit, and writes collapsed stacks for flamegraph tools.\n");
+	printf("--overlay shows frame, render and input times, instructions per second and drift, F3 toggles it.\n");
+	printf("--stats writes the same to a file every second, --stats-socket answers connections to a Unix domain socket with them.\n");
+}
+
 int main(int argc, char *argv[]) {
 	int windowWidth = 128;
 	int windowHeight = 64;
 	int windowScale = 16; //How big the pixels are
 	
+	int cyclesPerFrame = cyclesPerFrameNormal;
+	bool uncapped = false;
+	bool wallclockTimers = false;
+	bool jit = false;
+	enum quirkProfile quirks = quirksLegacy;
+	uint64_t seed = RNG_DEFAULT_SEED;
+	char *romPath = NULL;
+	char *statePath = NULL;
+	long rewindBudget = 0;
+	char *recordPath = NULL;
+	char *tracePath = NULL;
+	char *profilePath = NULL;
+	bool overlayVisible = false;
+	char *statsPath = NULL;
+	char *statsSocket = NULL;
+	
 	//Disable terminal output buffering
 	setbuf(stdout, NULL);
 	
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--ipf") == 0 && i + 1 < argc) {
+			cyclesPerFrame = atoi(argv[++i]);
+			if (cyclesPerFrame < 1) {
+				printf("Instructions per frame must be at least 1\n");
+				return -1;
+			}
+		} else if (strcmp(argv[i], "--uncapped") == 0) {
+			uncapped = true;
+		} else if (strcmp(argv[i], "--wallclock-timers") == 0) {
+			wallclockTimers = true;
+		} else if (strcmp(argv[i], "--jit") == 0) {
+			jit = true;
+		} else if (strcmp(argv[i], "--quirks") == 0 && i + 1 < argc) {
+			if (!quirks_find(argv[++i], &quirks)) {
+				printf("Unknown quirk profile %s, use legacy, vip, chip48, schip or modern\n", argv[i]);
+				return -1;
+			}
+		} else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			seed = strtoull(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "--rewind") == 0 && i + 1 < argc) {
+			rewindBudget = atol(argv[++i]) * 1024 * 1024;
+		} else if (strcmp(argv[i], "--state") == 0 && i + 1 < argc) {
+			statePath = argv[++i];
+		} else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			recordPath = argv[++i];
+		} else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			tracePath = argv[++i];
+		} else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+			profilePath = argv[++i];
+		} else if (strcmp(argv[i], "--overlay") == 0) {
+			overlayVisible = true;
+		} else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+			statsPath = argv[++i];
+		} else if (strcmp(argv[i], "--stats-socket") == 0 && i + 1 < argc) {
+			statsSocket = argv[++i];
+		} else if (!romPath) {
+			romPath = argv[i];
+		} else {
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+	
+#ifndef CPU_AOT
+	if (!romPath && !statePath) {
+		printf("Please provide a ROM filepath as argument!\n");
+		print_usage(argv[0]);
+		return -1;
+	}
+#endif
+	//Movies start from the ROM, and only replay exactly if nothing but the keys steers the run
+	if (recordPath && (statePath || rewindBudget > 0 || wallclockTimers)) {
+		printf("--record doesn't go with --state, --rewind or --wallclock-timers\n");
+		return -1;
+	}
+	
 	SDL_Window *window = NULL;
 	SDL_Renderer *renderer = NULL;
 	
@@ -255,74 +375,238 @@ int main(int argc, char *argv[]) {
 		return false;
 	}
 	
-	//Init renderer
-	renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+	//Init renderer, presenting in step with the display
+	renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
 	if (renderer == NULL) {
 		printf("Renderer couldn't be created, error %s", SDL_GetError());
 		return false;
 	}
-	SDL_RenderSetScale(renderer, windowScale, windowScale);
+	
+	struct renderer display;
+	if (!renderer_init(&display, renderer)) {
+		return false;
+	}
 	
 	//Initialize the emulator
-	cpu_initialize();
+	static struct emulation emu;
+	emu.machine = chip8_create(cyclesPerFrame);
+	if (!emu.machine) {
+		printf("Couldn't create the emulator\n");
+		return -1;
+	}
 	
-	if (argc == 2) {
-		switch (cpu_load_rom(argv[1])) {
-			case -1:
-				printf("Couldn't find the ROM file! (Check working dir/path)\n");
-				return -1;
-				break;
-			case -2:
-				printf("ROM too big\n");
-				return -1;
-				break;
-				
-			default:
-				printf(" bytes loaded.\n");
-				break;
+	//Resume where the last run with this state file left off, or start the ROM if there's nothing to resume
+	int stateResult = -1;
+	if (statePath) {
+		stateResult = chip8_load_state_file(emu.machine, statePath);
+		if (stateResult == 0) {
+			printf("Resuming from %s\n", statePath);
+		} else if (stateResult != -1) {
+			printf("Save state %s is %s, starting over\n", statePath, stateResult == -2 ? "from another version" : "corrupted");
 		}
-	} else {
-		printf("Please provide a ROM filepath as argument!\n");
+	}
+	
+	int loadResult = 0;
+	static struct movie movie;
+	if (stateResult != 0) {
+		chip8_set_seed(emu.machine, seed, 0);
+#ifdef CPU_AOT
+		//Native build of a single ROM, which is built in. Another ROM can still be given, it just gets interpreted.
+		if (!romPath) {
+			printf("%s: %ld bytes built in\n", aotRomName, aotRomSize);
+			chip8_set_quirks(emu.machine, aotQuirks);
+			loadResult = chip8_load_rom(emu.machine, aotRom, aotRomSize);
+			if (recordPath) movie_init(&movie, emu.machine, aotQuirks, aotRom, aotRomSize);
+		} else
+#endif
+		if (!romPath) {
+			printf("No save state to resume from, and no ROM given\n");
+			return -1;
+		} else {
+			chip8_set_quirks(emu.machine, quirks);
+			//Movies keep the ROM's CRC, so read it in first
+			static unsigned char rom[CHIP8_MAX_ROM_SIZE];
+			long romSize = 0;
+			loadResult = chip8_read_rom_file(romPath, rom, &romSize);
+			if (loadResult == 0) loadResult = chip8_load_rom(emu.machine, rom, romSize);
+			if (loadResult == 0 && recordPath) movie_init(&movie, emu.machine, quirks, rom, romSize);
+		}
+		if (recordPath) emu.movie = &movie;
+	}
+	
+	switch (loadResult) {
+		case -1:
+			printf("Couldn't find the ROM file! (Check working dir/path)\n");
+			return -1;
+			break;
+		case -2:
+			printf("ROM too big\n");
+			return -1;
+			break;
+			
+		default:
+			break;
+	}
+	
+	//Timers tick once per frame worth of cycles, unless told to follow the wall clock
+	chip8_set_wallclock_timers(emu.machine, wallclockTimers);
+	if (jit && !chip8_set_jit(emu.machine, true)) {
+		printf("JIT recompiler not built in, using the interpreter\n");
+	}
+	
+	//Check for CTRL-C
+	if (signal(SIGINT, sig_handler) == SIG_ERR) {
+		printf("Couldn't catch SIGINT\n");
+	}
+	
+	static struct rewind_buffer history;
+	if (rewindBudget > 0) {
+		if (!rewind_init(&history, rewindBudget)) {
+			printf("Couldn't set up a %ldMB rewind buffer\n", rewindBudget / (1024 * 1024));
+			return -1;
+		}
+		emu.history = &history;
+	}
+	
+	if (profilePath && !chip8_profile_start(emu.machine)) {
+		printf("Profiler not built in, configure with -DCPU_PROFILE=ON\n");
 		return -1;
 	}
+	if (tracePath) {
+		emu.tracePath = tracePath;
+		toggle_trace(&emu);
+	}
 	
-	//Start counter decrement loop.
+	SDL_AddEventWatch(input_watcher, NULL);
 	
-	struct thread decrementer = (struct thread){.threadFunc = decrement_counters};
+	scheduler_init(&emu.sched, uncapped);
+	tribuf_init(&emu.frames);
+	atomic_init(&emu.framesRun, 0);
 	
-	startThread(&decrementer);
+	//Metrics are always kept, they're only a few samples a frame. Showing and exporting them is optional.
+	static struct metrics metrics;
+	metrics_init(&metrics);
+	scheduler_set_metrics(&emu.sched, &metrics);
+	static struct metrics_exporter exporter;
+	if ((statsPath || statsSocket) && !metrics_export_start(&exporter, &metrics, statsPath, statsSocket)) {
+		printf("Couldn't export the metrics to %s\n", statsSocket ? statsSocket : statsPath);
+		return -1;
+	}
+	static struct overlay overlay;
+	if (!overlay_init(&overlay, renderer)) {
+		return -1;
+	}
+	
+	//Emulation gets its own thread. Rendering stays here, SDL wants it on the thread that made the window.
+	struct thread emuThread = {0};
+	emuThread.threadFunc = emulation_thread;
+	emuThread.userData = &emu;
+	if (startThread(&emuThread)) {
+		printf("Couldn't start the emulation thread\n");
+		return -1;
+	}
 	
-	//Emulation loop
-	do {
-		//Check for CTRL-C
-		if (signal(SIGINT, sig_handler) == SIG_ERR) {
-			printf("Couldn't catch SIGINT\n");
+	//Render loop, one iteration per display refresh
+	int refreshRate = FRAME_RATE;
+	SDL_DisplayMode mode;
+	if (SDL_GetCurrentDisplayMode(0, &mode) == 0 && mode.refresh_rate > 0) {
+		refreshRate = mode.refresh_rate;
+	}
+	long long refreshLength = NSEC_PER_SEC / refreshRate;
+	long long nextRefresh = time_now_ns();
+	unsigned long long presented = 0;
+	unsigned long long duplicated = 0;
+	//Input latency, split into until the ROM read the keys and from then until the frame was presented
+	unsigned long long latencySamples = 0;
+	long long latencyUntilRead = 0;
+	long long latencyUntilPresent = 0;
+	while (emulatorRunning) {
+		//Input is handled by input_watcher() as the events go by, the queue itself isn't needed
+		long long inputStart = time_now_ns();
+		SDL_PumpEvents();
+		SDL_FlushEvents(SDL_FIRSTEVENT, SDL_LASTEVENT);
+		long long renderStart = time_now_ns();
+		metrics_record(&metrics, metricInputTime, renderStart - inputStart);
+		//Taken before acquiring, so what's shown below is at least as new as this emulation frame.
+		//Frames that drew nothing are never published, what's on screen already matches them.
+		unsigned long long shownFrame = atomic_load_explicit(&emu.framesRun, memory_order_acquire);
+		//Show the newest frame. Rows are compared against what's on screen, so rows drawn in frames
+		//that were dropped in between aren't lost.
+		struct frame *frame = tribuf_acquire(&emu.frames);
+		if (frame) {
+			renderer_update(&display, frame->rows, 0xFFFFFFFF);
+			presented++;
+		} else {
+			duplicated++;
 		}
-		//Run the CPU cycle
-		cpu_emulate_cycle();
-		//Draw if needed
-		if (cpu_is_drawflag_set()) {
-			render(renderer);
+		if (atomic_exchange_explicit(&overlayToggled, false, memory_order_relaxed)) {
+			overlayVisible = !overlayVisible;
+			overlay.nextUpdate = 0;
+			display.needsPresent = true;
 		}
-		//Check if CPU has halted
-		if (cpu_has_halted()) {
-			emulatorRunning = false;
+		display.overlay = overlayVisible ? overlay.texture : NULL;
+		if (overlayVisible && overlay_update(&overlay, &metrics)) {
+			display.needsPresent = true;
 		}
-		//Set keyboard input to CPU
-		set_input();
-		//Delay
-		
-		int ms;
-		
-		if (CPU_DEBUG && delayEnabled) {
-			ms = delayDebug;
+		renderer_present(&display);
+		long long presentedAt = time_now_ns();
+		metrics_record(&metrics, metricRenderTime, presentedAt - renderStart);
+		//A key change is done once the display from the frame the ROM read it in is on screen, whether that frame drew or not
+		long long keyTime = atomic_load_explicit(&emu.latency.keyTime, memory_order_acquire);
+		if (keyTime && shownFrame >= emu.latency.frame) {
+			metrics_record(&metrics, metricInputLatency, presentedAt - keyTime);
+			latencySamples++;
+			latencyUntilRead += emu.latency.readTime - keyTime;
+			latencyUntilPresent += presentedAt - emu.latency.readTime;
+			atomic_store_explicit(&emu.latency.keyTime, 0, memory_order_release);
 		}
-		else {
-			ms = delayNormal;
+		//Vsync paces us if the driver honours it, this covers for when it doesn't
+		nextRefresh += refreshLength;
+		long long now = time_now_ns();
+		if (nextRefresh > now) {
+			time_sleep_until_ns(nextRefresh);
+		} else {
+			nextRefresh = now;
 		}
-		sleepMSec(ms);
-	} while (emulatorRunning);
+	}
+	
+	checkThread(&emuThread);
+	if (statsPath || statsSocket) metrics_export_stop(&exporter);
+	scheduler_print_stats(&emu.sched);
+	printf("Frames: %llu presented, %llu dropped, %llu duplicated\n", presented,
+		   (unsigned long long)atomic_load(&emu.frames.dropped), duplicated);
+	if (latencySamples) {
+		struct metricSnapshot latency;
+		metrics_snapshot(&metrics, metricInputLatency, &latency);
+		printf("Input latency: p50 %.1fms, p99 %.1fms over the last %u key changes, on average %.1fms until the ROM read them and %.1fms more until presented\n",
+			   metrics_percentile(&latency, 0.5) / 1e6, metrics_percentile(&latency, 0.99) / 1e6, latency.count,
+			   (double)latencyUntilRead / latencySamples / 1e6, (double)latencyUntilPresent / latencySamples / 1e6);
+	}
 	
+	SDL_DelEventWatch(input_watcher, NULL);
+	if (emu.tracing) toggle_trace(&emu);
+	if (profilePath && chip8_profile_finish(emu.machine, profilePath) != 0) {
+		printf("Couldn't write the stacks %s\n", profilePath);
+	}
+	if (emu.history) {
+		rewind_print_stats(emu.history);
+		rewind_destroy(emu.history);
+	}
+	if (statePath && chip8_save_state_file(emu.machine, statePath) != 0) {
+		printf("Couldn't write the save state %s\n", statePath);
+	}
+	if (emu.movie) {
+		movie_finish(emu.movie, emu.machine);
+		if (movie_save(emu.movie, recordPath) == 0) {
+			printf("Recorded %llu frames to %s\n", emu.movie->frames, recordPath);
+		} else {
+			printf("Couldn't write the movie %s\n", recordPath);
+		}
+	}
+	movie_destroy(&movie);
+	chip8_destroy(emu.machine);
+	overlay_destroy(&overlay);
+	renderer_destroy(&display);
 	destroy_renderer(renderer);
 	destroy_window(window);
 	
@@ -0,0 +1,247 @@
+//
+//  metrics.c
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "metrics.h"
+#include "bits.h"
+#include "timing.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WINDOWS
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+//How often the exporter writes the file, and looks for connections between writes
+#define EXPORT_INTERVAL NSEC_PER_SEC
+#define EXPORT_POLL_MS 100
+
+const char *metricNames[metricCount] = {
+	[metricIPS] = "chip8_instructions_per_second",
+	[metricFrameTime] = "chip8_frame_time_ns",
+	[metricRenderTime] = "chip8_render_time_ns",
+	[metricInputTime] = "chip8_input_time_ns",
+	[metricTimerDrift] = "chip8_timer_drift_ns",
+	[metricInputLatency] = "chip8_input_latency_ns",
+};
+
+static int bucket_for(uint64_t value) {
+	if (value < METRICS_SUB_BUCKETS) return (int)value;
+	int exponent = highest_bit(value);
+	return (exponent - 2) * METRICS_SUB_BUCKETS + (int)((value >> (exponent - 3)) & (METRICS_SUB_BUCKETS - 1));
+}
+
+uint64_t metrics_bucket_value(int bucket) {
+	if (bucket < METRICS_SUB_BUCKETS) return bucket;
+	int exponent = bucket / METRICS_SUB_BUCKETS + 2;
+	uint64_t width = 1ULL << (exponent - 3);
+	return (METRICS_SUB_BUCKETS + bucket % METRICS_SUB_BUCKETS) * width + width / 2;
+}
+
+void metrics_init(struct metrics *m) {
+	for (int i = 0; i < metricCount; ++i) {
+		struct histogram *h = &m->histograms[i];
+		h->next = 0;
+		h->filled = 0;
+		for (int b = 0; b < METRICS_BUCKETS; ++b) atomic_init(&h->buckets[b], 0);
+		atomic_init(&h->sum, 0);
+		atomic_init(&h->count, 0);
+	}
+}
+
+//Only the one writer changes a histogram, so it can update its counts without read-modify-write atomics
+static void add(atomic_uint *counter, int amount) {
+	atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+void metrics_record(struct metrics *m, enum metric which, uint64_t value) {
+	struct histogram *h = &m->histograms[which];
+	if (h->filled == METRICS_WINDOW) {
+		add(&h->buckets[bucket_for(h->window[h->next])], -1);
+	} else {
+		h->filled++;
+	}
+	h->window[h->next] = value;
+	h->next = (h->next + 1) % METRICS_WINDOW;
+	add(&h->buckets[bucket_for(value)], 1);
+	atomic_store_explicit(&h->sum, atomic_load_explicit(&h->sum, memory_order_relaxed) + value, memory_order_relaxed);
+	atomic_store_explicit(&h->count, atomic_load_explicit(&h->count, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+void metrics_snapshot(struct metrics *m, enum metric which, struct metricSnapshot *s) {
+	struct histogram *h = &m->histograms[which];
+	s->count = 0;
+	s->lowest = -1;
+	s->highest = -1;
+	for (int b = 0; b < METRICS_BUCKETS; ++b) {
+		s->buckets[b] = atomic_load_explicit(&h->buckets[b], memory_order_relaxed);
+		if (!s->buckets[b]) continue;
+		s->count += s->buckets[b];
+		if (s->lowest < 0) s->lowest = b;
+		s->highest = b;
+	}
+	s->lifetimeSum = atomic_load_explicit(&h->sum, memory_order_relaxed);
+	s->lifetimeCount = atomic_load_explicit(&h->count, memory_order_relaxed);
+}
+
+uint64_t metrics_percentile(const struct metricSnapshot *s, double fraction) {
+	if (!s->count) return 0;
+	unsigned int rank = (unsigned int)(fraction * s->count + 0.5);
+	if (rank < 1) rank = 1;
+	unsigned int seen = 0;
+	for (int b = s->lowest; b <= s->highest; ++b) {
+		seen += s->buckets[b];
+		if (seen >= rank) return metrics_bucket_value(b);
+	}
+	return metrics_bucket_value(s->highest);
+}
+
+void metrics_write(struct metrics *m, FILE *out) {
+	static const double quantiles[] = { 0.5, 0.9, 0.99 };
+	struct metricSnapshot s;
+	for (int i = 0; i < metricCount; ++i) {
+		metrics_snapshot(m, i, &s);
+		fprintf(out, "# TYPE %s summary\n", metricNames[i]);
+		for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); ++q) {
+			fprintf(out, "%s{quantile=\"%g\"} %llu\n", metricNames[i], quantiles[q],
+					(unsigned long long)metrics_percentile(&s, quantiles[q]));
+		}
+		fprintf(out, "%s{quantile=\"1\"} %llu\n", metricNames[i],
+				s.count ? (unsigned long long)metrics_bucket_value(s.highest) : 0);
+		//Collectors take these as counters, so they keep going up for the whole run while the quantiles roll
+		fprintf(out, "%s_sum %llu\n", metricNames[i], s.lifetimeSum);
+		fprintf(out, "%s_count %llu\n", metricNames[i], s.lifetimeCount);
+	}
+}
+
+//Written next to the file and renamed over it, so nothing reading it ever sees half of one
+static void write_file(struct metrics_exporter *e) {
+	char temporary[1024];
+	if (snprintf(temporary, sizeof(temporary), "%s.tmp", e->filePath) >= (int)sizeof(temporary)) return;
+	FILE *file = fopen(temporary, "w");
+	if (!file) return;
+	metrics_write(e->metrics, file);
+	if (fclose(file) != 0) return;
+#ifdef WINDOWS
+	remove(e->filePath);
+#endif
+	rename(temporary, e->filePath);
+}
+
+#ifndef WINDOWS
+
+static int open_socket(const char *path) {
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+	strcpy(addr.sun_path, path);
+	int s = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (s < 0) return -1;
+	//An earlier run may have left its socket behind, but don't remove anything else that's there
+	struct stat existing;
+	if (lstat(path, &existing) == 0 && S_ISSOCK(existing.st_mode)) unlink(path);
+	if (bind(s, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(s, 4) != 0) {
+		close(s);
+		return -1;
+	}
+	return s;
+}
+
+//Wait up to EXPORT_POLL_MS for someone to connect, and hand them the metrics
+static void serve(struct metrics_exporter *e) {
+	struct pollfd listener = { .fd = e->socket, .events = POLLIN };
+	if (poll(&listener, 1, EXPORT_POLL_MS) <= 0) return;
+	int client = accept(e->socket, NULL, NULL);
+	if (client < 0) return;
+	char *text = NULL;
+	size_t length = 0;
+	FILE *buffer = open_memstream(&text, &length);
+	if (buffer) {
+		metrics_write(e->metrics, buffer);
+		fclose(buffer);
+		//A collector that hangs up early shouldn't take the emulator down with SIGPIPE
+		for (size_t sent = 0; sent < length;) {
+			ssize_t n = send(client, text + sent, length - sent, MSG_NOSIGNAL);
+			if (n <= 0) break;
+			sent += n;
+		}
+		free(text);
+	}
+	close(client);
+}
+
+#endif
+
+static void *exporter_thread(void *arg) {
+	struct thread *t = (struct thread *)arg;
+	struct metrics_exporter *e = (struct metrics_exporter *)t->userData;
+	long long nextWrite = time_now_ns() + EXPORT_INTERVAL;
+	while (!atomic_load_explicit(&e->stopping, memory_order_acquire)) {
+		if (e->filePath && time_now_ns() >= nextWrite) {
+			write_file(e);
+			nextWrite += EXPORT_INTERVAL;
+		}
+#ifndef WINDOWS
+		if (e->socket >= 0) {
+			serve(e);
+			continue;
+		}
+#endif
+		time_sleep_until_ns(time_now_ns() + EXPORT_POLL_MS * 1000000LL);
+	}
+	t->threadComplete = true;
+	return NULL;
+}
+
+bool metrics_export_start(struct metrics_exporter *e, struct metrics *m, const char *filePath, const char *socketPath) {
+	e->metrics = m;
+	e->filePath = filePath;
+	e->socketPath = socketPath;
+	e->socket = -1;
+	atomic_init(&e->stopping, false);
+	if (socketPath) {
+#ifdef WINDOWS
+		//No Unix domain sockets here, the file still works
+		return false;
+#else
+		e->socket = open_socket(socketPath);
+		if (e->socket < 0) return false;
+#endif
+	}
+	memset(&e->thread, 0, sizeof(e->thread));
+	e->thread.threadFunc = exporter_thread;
+	e->thread.userData = e;
+	if (startThread(&e->thread)) {
+#ifndef WINDOWS
+		if (e->socket >= 0) {
+			close(e->socket);
+			unlink(socketPath);
+		}
+#endif
+		return false;
+	}
+	return true;
+}
+
+void metrics_export_stop(struct metrics_exporter *e) {
+	atomic_store_explicit(&e->stopping, true, memory_order_release);
+	checkThread(&e->thread);
+	if (e->filePath) write_file(e);
+#ifndef WINDOWS
+	if (e->socket >= 0) {
+		close(e->socket);
+		unlink(e->socketPath);
+		e->socket = -1;
+	}
+#endif
+}
@@ -0,0 +1,101 @@
+//
+//  metrics.h
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#ifndef metrics_h
+#define metrics_h
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "thread.h"
+
+//Runtime metrics, kept as rolling histograms over the last METRICS_WINDOW samples of each,
+//plus a running total and count of every sample since the start.
+//Each metric is recorded by one thread only, the one doing the work it measures. Any thread can
+//read them at any time, readers see bucket counts that are at most a sample or two out of step.
+
+enum metric {
+	metricIPS,		   //Emulated instructions per second, over each frame
+	metricFrameTime,   //Host time from one emulated frame to the next, ns
+	metricRenderTime,  //Texture upload and present, ns
+	metricInputTime,   //Pumping the SDL event queue, ns
+	metricTimerDrift,  //How late the 60Hz frame deadline was woken up for, ns
+	metricInputLatency, //From a key changing to the first frame presented after the ROM read it, ns
+	metricCount
+};
+
+//Names as exported, see metrics_write()
+extern const char *metricNames[metricCount];
+
+//Samples each histogram covers
+#define METRICS_WINDOW 600
+
+//Buckets are exact below 8, then 8 to a power of two, so they're never more than 12.5% wide
+#define METRICS_SUB_BUCKETS 8
+#define METRICS_BUCKETS 512
+
+struct histogram {
+	//Writer only. The samples in the window, so the oldest can be taken out again.
+	uint64_t window[METRICS_WINDOW];
+	unsigned int next;
+	unsigned int filled;
+	
+	atomic_uint buckets[METRICS_BUCKETS];
+	//Every sample ever recorded, not just the window
+	atomic_ullong sum;
+	atomic_ullong count;
+};
+
+struct metrics {
+	struct histogram histograms[metricCount];
+};
+
+//A copy of one histogram, to work out percentiles from without it changing underneath
+struct metricSnapshot {
+	unsigned int buckets[METRICS_BUCKETS];
+	unsigned int count;
+	int lowest, highest; //Nonempty buckets, -1 if there are none
+	unsigned long long lifetimeSum, lifetimeCount;
+};
+
+void metrics_init(struct metrics *m);
+
+//Add a sample, pushing the oldest one out once the window is full. Only one thread per metric.
+void metrics_record(struct metrics *m, enum metric which, uint64_t value);
+
+void metrics_snapshot(struct metrics *m, enum metric which, struct metricSnapshot *s);
+
+//Value below which fraction of the samples fall, to within a bucket. 0 with no samples.
+uint64_t metrics_percentile(const struct metricSnapshot *s, double fraction);
+
+//Middle of a bucket's range
+uint64_t metrics_bucket_value(int bucket);
+
+//Every metric's p50, p90, p99 and max over the window, and its lifetime sum and count, in the Prometheus text format
+void metrics_write(struct metrics *m, FILE *out);
+
+//Writes the metrics to a file every second, and/or answers connections to a Unix domain socket with them.
+//Runs on its own thread.
+struct metrics_exporter {
+	struct metrics *metrics;
+	const char *filePath;
+	const char *socketPath;
+	int socket;
+	struct thread thread;
+	atomic_bool stopping;
+};
+
+//Start exporting to filePath and/or socketPath, either can be NULL.
+//Returns false if the socket can't be set up or the thread can't be started.
+bool metrics_export_start(struct metrics_exporter *e, struct metrics *m, const char *filePath, const char *socketPath);
+
+//Write the file one last time and shut the socket
+void metrics_export_stop(struct metrics_exporter *e);
+
+#endif /* metrics_h */
@@ -0,0 +1,180 @@
+//
+//  movie.c
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "movie.h"
+#include "crc32.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MOVIE_MAGIC "C8MV"
+
+static void put16(unsigned char *p, uint16_t value) {
+	p[0] = value;
+	p[1] = value >> 8;
+}
+
+static void put32(unsigned char *p, uint32_t value) {
+	put16(p, value);
+	put16(p + 2, value >> 16);
+}
+
+static void put64(unsigned char *p, uint64_t value) {
+	put32(p, (uint32_t)value);
+	put32(p + 4, (uint32_t)(value >> 32));
+}
+
+static uint16_t get16(const unsigned char *p) {
+	return p[0] | p[1] << 8;
+}
+
+static uint32_t get32(const unsigned char *p) {
+	return get16(p) | (uint32_t)get16(p + 2) << 16;
+}
+
+static uint64_t get64(const unsigned char *p) {
+	return get32(p) | (uint64_t)get32(p + 4) << 32;
+}
+
+void movie_init(struct movie *m, struct chip8 *c, enum quirkProfile quirks, const unsigned char *rom, long romSize) {
+	memset(m, 0, sizeof(*m));
+	m->cyclesPerFrame = chip8_cycles_per_frame(c);
+	m->quirks = quirks;
+	m->seed = chip8_seed(c);
+	m->stream = chip8_stream(c);
+	m->romCrc = crc32(rom, romSize);
+}
+
+void movie_destroy(struct movie *m) {
+	free(m->runs);
+	memset(m, 0, sizeof(*m));
+}
+
+bool movie_record_frame(struct movie *m, uint16_t keys) {
+	struct movie_run *last = m->runCount ? &m->runs[m->runCount - 1] : NULL;
+	if (last && last->keys == keys && last->frames < UINT32_MAX) {
+		last->frames++;
+	} else {
+		if (m->runCount == m->runCapacity) {
+			size_t capacity = m->runCapacity ? m->runCapacity * 2 : 256;
+			struct movie_run *runs = realloc(m->runs, capacity * sizeof(*runs));
+			if (!runs) return false;
+			m->runs = runs;
+			m->runCapacity = capacity;
+		}
+		m->runs[m->runCount++] = (struct movie_run){ keys, 1 };
+	}
+	m->frames++;
+	return true;
+}
+
+unsigned long long movie_display_hash(struct chip8 *c) {
+	uint64_t rows[CHIP8_DISPLAY_HEIGHT];
+	chip8_read_framebuffer(c, rows);
+	unsigned long long hash = 0xcbf29ce484222325ULL;
+	for (int r = 0; r < CHIP8_DISPLAY_HEIGHT; ++r) {
+		for (int b = 0; b < 8; ++b) {
+			hash ^= (rows[r] >> (b * 8)) & 0xFF;
+			hash *= 0x100000001b3ULL;
+		}
+	}
+	return hash;
+}
+
+void movie_finish(struct movie *m, struct chip8 *c) {
+	m->cycles = chip8_cycles(c);
+	m->displayHash = movie_display_hash(c);
+}
+
+int movie_save(const struct movie *m, const char *path) {
+	FILE *file = fopen(path, "wb");
+	if (!file) return -1;
+	unsigned char header[MOVIE_HEADER_SIZE] = {0};
+	memcpy(header, MOVIE_MAGIC, 4);
+	put16(header + 0x04, MOVIE_VERSION);
+	header[0x06] = m->quirks;
+	put32(header + 0x08, m->cyclesPerFrame);
+	put32(header + 0x0C, m->romCrc);
+	put64(header + 0x10, m->seed);
+	put64(header + 0x18, m->stream);
+	put64(header + 0x20, m->frames);
+	put64(header + 0x28, m->cycles);
+	put64(header + 0x30, m->displayHash);
+	put32(header + 0x38, (uint32_t)m->runCount);
+	bool written = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+	for (size_t i = 0; i < m->runCount && written; ++i) {
+		unsigned char run[MOVIE_RUN_SIZE];
+		put16(run, m->runs[i].keys);
+		put32(run + 2, m->runs[i].frames);
+		written = fwrite(run, 1, sizeof(run), file) == sizeof(run);
+	}
+	return fclose(file) == 0 && written ? 0 : -1;
+}
+
+int movie_load(struct movie *m, const char *path) {
+	memset(m, 0, sizeof(*m));
+	FILE *file = fopen(path, "rb");
+	if (!file) return -1;
+	unsigned char header[MOVIE_HEADER_SIZE];
+	if (fread(header, 1, sizeof(header), file) != sizeof(header) || memcmp(header, MOVIE_MAGIC, 4) != 0 ||
+		get16(header + 0x04) != MOVIE_VERSION || header[0x06] >= quirkProfileCount || get32(header + 0x08) == 0) {
+		fclose(file);
+		return -2;
+	}
+	m->quirks = header[0x06];
+	m->cyclesPerFrame = get32(header + 0x08);
+	m->romCrc = get32(header + 0x0C);
+	m->seed = get64(header + 0x10);
+	m->stream = get64(header + 0x18);
+	m->frames = get64(header + 0x20);
+	m->cycles = get64(header + 0x28);
+	m->displayHash = get64(header + 0x30);
+	m->runCount = get32(header + 0x38);
+
+	m->runs = malloc((m->runCount ? m->runCount : 1) * sizeof(*m->runs));
+	m->runCapacity = m->runCount;
+	unsigned long long frames = 0;
+	for (size_t i = 0; i < m->runCount && m->runs; ++i) {
+		unsigned char run[MOVIE_RUN_SIZE];
+		if (fread(run, 1, sizeof(run), file) != sizeof(run)) break;
+		m->runs[i].keys = get16(run);
+		m->runs[i].frames = get32(run + 2);
+		frames += m->runs[i].frames;
+	}
+	fclose(file);
+	//Truncated, or the runs don't add up to the frames it says it has
+	if (!m->runs || frames != m->frames) {
+		movie_destroy(m);
+		return -2;
+	}
+	return 0;
+}
+
+int movie_start_replay(struct movie *m, struct chip8 *c, const unsigned char *rom, long romSize) {
+	if (crc32(rom, romSize) != m->romCrc) return -1;
+	m->replayRun = 0;
+	m->replayFrame = 0;
+	chip8_set_seed(c, m->seed, m->stream);
+	chip8_set_quirks(c, m->quirks);
+	return chip8_load_rom(c, rom, romSize);
+}
+
+bool movie_replay_frame(struct movie *m, uint16_t *keys) {
+	while (m->replayRun < m->runCount && m->replayFrame == m->runs[m->replayRun].frames) {
+		m->replayRun++;
+		m->replayFrame = 0;
+	}
+	if (m->replayRun == m->runCount) return false;
+	*keys = m->runs[m->replayRun].keys;
+	m->replayFrame++;
+	return true;
+}
+
+bool movie_check(const struct movie *m, struct chip8 *c) {
+	return chip8_cycles(c) == m->cycles && movie_display_hash(c) == m->displayHash;
+}
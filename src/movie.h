@@ -0,0 +1,97 @@
+//
+//  movie.h
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#ifndef movie_h
+#define movie_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "chip8.h"
+
+//Input movies, the keys held on every frame of a run. A machine started the same way and fed the
+//same keys runs exactly the same, so a movie replays a run instruction for instruction.
+//Keys are kept as runs of frames they stayed the same for. The ROM's CRC, the settings it ran with,
+//and how the run ended are kept too, so a replay can tell if it's still in sync.
+//
+//File, little-endian
+// 0x00 "C8MV"
+// 0x04 u16 version
+// 0x06 u8  quirk profile
+// 0x07 u8  reserved, 0
+// 0x08 u32 instructions per frame
+// 0x0C u32 CRC-32 of the ROM
+// 0x10 u64 RNG seed
+// 0x18 u64 RNG stream
+// 0x20 u64 frames
+// 0x28 u64 cycles at the end
+// 0x30 u64 display hash at the end
+// 0x38 u32 number of runs, u32 reserved, 0
+// 0x40 runs, u16 key mask and u32 frames each
+#define MOVIE_VERSION 2
+#define MOVIE_HEADER_SIZE 0x40
+#define MOVIE_RUN_SIZE 6
+
+struct movie_run {
+	uint16_t keys;
+	uint32_t frames;
+};
+
+struct movie {
+	//How the machine was set up
+	int cyclesPerFrame;
+	enum quirkProfile quirks;
+	uint64_t seed;
+	uint64_t stream;
+	uint32_t romCrc;
+
+	struct movie_run *runs;
+	size_t runCount;
+	size_t runCapacity;
+	unsigned long long frames;
+
+	//How the run ended, set by movie_finish()
+	unsigned long long cycles;
+	unsigned long long displayHash;
+
+	//Replay position
+	size_t replayRun;
+	uint32_t replayFrame;
+};
+
+//Start recording a run of the given ROM, with the machine already set up as it'll run
+void movie_init(struct movie *m, struct chip8 *c, enum quirkProfile quirks, const unsigned char *rom, long romSize);
+void movie_destroy(struct movie *m);
+
+//Add a frame, with the keys it's about to run with. Returns false if out of memory.
+bool movie_record_frame(struct movie *m, uint16_t keys);
+
+//Note down where the run ended up, for replays to check against
+void movie_finish(struct movie *m, struct chip8 *c);
+
+//Returns 0 on success, -1 if the file can't be written
+int movie_save(const struct movie *m, const char *path);
+
+//Returns 0 on success, -1 if the file can't be read, -2 if it isn't a movie this version can read
+int movie_load(struct movie *m, const char *path);
+
+//Set a fresh machine up the way the recording started, with the ROM it was made with.
+//The machine has to be created with the movie's cyclesPerFrame.
+//Returns 0 on success, -1 if it's a different ROM, otherwise as chip8_load_rom().
+int movie_start_replay(struct movie *m, struct chip8 *c, const unsigned char *rom, long romSize);
+
+//Keys for the next frame of a replay. Returns false once the movie is over.
+bool movie_replay_frame(struct movie *m, uint16_t *keys);
+
+//True if the machine ended up where the recording did
+bool movie_check(const struct movie *m, struct chip8 *c);
+
+//FNV-1a over the display, the same hash chip8-headless prints
+unsigned long long movie_display_hash(struct chip8 *c);
+
+#endif /* movie_h */
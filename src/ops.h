@@ -0,0 +1,274 @@
+//
+//  ops.h
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+//Instruction implementations, shared by every dispatch engine in CPU.c, the lanes in lockstep.c,
+//and by code generated with chip8-aot. Nothing else should include this.
+//This is a template, included once per quirk profile with QUIRK_PROFILE set to one.
+//Every handler is named op_<pattern>_<profile>, and quirk checks read a constant.
+
+#ifndef QUIRK_PROFILE
+#error "Define QUIRK_PROFILE before including ops.h"
+#endif
+
+#include "bits.h"
+#include "decode.h"
+#include "quirks.h"
+
+#ifndef PROFILED
+#define PROFILED_NAME(name, profile) name##_##profile
+#define PROFILED_EXPAND(name, profile) PROFILED_NAME(name, profile)
+//name_<current profile>
+#define PROFILED(name) PROFILED_EXPAND(name, QUIRK_PROFILE)
+#endif
+
+#define QUIRK(field) (quirkProfiles[QUIRK_PROFILE].field)
+
+static inline void PROFILED(op_UNKNOWN)(chipCPU *cpu, struct instr in) {
+	//Stop this machine, not the whole process
+	if (!cpu->quiet) printf("Unknown opcode: 0x%X\n", cpu->currentOP);
+	cpu->running = false;
+}
+
+static inline void PROFILED(op_00E0)(chipCPU *cpu, struct instr in) { // 0x00E0: Clear the screen
+	memset(cpu->display, 0x0, sizeof(cpu->display));
+	cpu->drawFlag = true;
+	cpu->dirtyRows = 0xFFFFFFFF;
+	cpu->sideEffects++;
+	cpu->progCounter += 2;
+}
+
+static inline void PROFILED(op_00EE)(chipCPU *cpu, struct instr in) { // 0x00EE: Return from subroutine
+	--cpu->stackPointer;
+	//Pop PC off the stack and continue executing
+	cpu->progCounter = cpu->stack[cpu->stackPointer];
+}
+
+static inline void PROFILED(op_1NNN)(chipCPU *cpu, struct instr in) { // 0x1NNN: Jump to address NNN
+	//Don't increment the program counter because we're jumping to an address
+	//Autohalt, automatically hault execution if infinite loop is detected
+	unsigned short from = cpu->progCounter;
+	if (AUTOHALT && (from & 0x0FFF) == in.nnn) {
+		printf("Infinite loop detected, halting execution.\n");
+		cpu->running = false;
+	}
+	cpu->progCounter = in.nnn;
+	//Jumping backwards closes a loop, which might just be waiting on the delay timer
+	if (in.nnn <= from) cpu_idle_jump(cpu, from);
+}
+
+static inline void PROFILED(op_2NNN)(chipCPU *cpu, struct instr in) { // 0x2NNN: Call subroutine at NNN
+	//Increment PC before saving it into stack, so when returning, we can just pop the PC and continue executing
+	cpu->progCounter += 2;
+	cpu->stack[cpu->stackPointer] = cpu->progCounter;
+	++cpu->stackPointer;
+	cpu->progCounter = in.nnn;
+}
+
+static inline void PROFILED(op_3XNN)(chipCPU *cpu, struct instr in) { // 0x3XNN: Skip the next instruction if VX equals NN
+	cpu->progCounter += cpu->V[in.x] == in.nn ? 4 : 2;
+}
+
+static inline void PROFILED(op_4XNN)(chipCPU *cpu, struct instr in) { // 0x4XNN: Skip the next instruction if VX doesn't equal NN
+	cpu->progCounter += cpu->V[in.x] != in.nn ? 4 : 2;
+}
+
+static inline void PROFILED(op_5XY0)(chipCPU *cpu, struct instr in) { // 0x5XY0: Skip the next instruction if VX equals VY
+	cpu->progCounter += cpu->V[in.x] == cpu->V[in.y] ? 4 : 2;
+}
+
+static inline void PROFILED(op_6XNN)(chipCPU *cpu, struct instr in) { // 0x6XNN: Set VX to NN
+	cpu->V[in.x] = in.nn;
+	cpu->progCounter += 2;
+}
+
+static inline void PROFILED(op_7XNN)(chipCPU *cpu, struct instr in) { // 0x7XNN: Add NN to VX
+	cpu->V[in.x] += in.nn;
+	cpu->progCounter += 2;
+}
+
+static inline void PROFILED(op_8XY0)(chipCPU *cpu, struct instr in) { // 0x8XY0: Set VX to the value of VY
+	cpu->V[in.x] = cpu->V[in.y];
+	cpu->progCounter += 2;
+}
+
+static inline void PROFILED(op_8XY1)(chipCPU *cpu, struct instr in) { // 0x8XY1: Set VX to VX or VY
+	cpu->V[in.x] |= cpu->V[in.y];
+	if (QUIRK(logicResetsVF)) cpu->V[0xF] = 0;
+	cpu->progCounter += 2;
+}
+
+static inline void PROFILED(op_8XY2)(chipCPU *cpu, struct instr in) { // 0x8XY2: Set VX to VX and VY
+	cpu->V[in.x] &= cpu->V[in.y];
+	if (QUIRK(logicResetsVF)) cpu->V[0xF] = 0;
+	cpu->progCounter += 2;
+}
+
+static inline void PROFILED(op_8XY3)(chipCPU *cpu, struct instr in) { // 0x8XY3: Set VX to VX xor VY
+	cpu->V[in.x] ^= cpu->V[in.y];
+	if (QUIRK(logicResetsVF)) cpu->V[0xF] = 0;
+	cpu->progCounter += 2;
+}
+
+static inline void PROFILED(op_8XY4)(chipCPU *cpu, struct instr in) { // 0x8XY4: Add VY to VX. VF is set to 1 when there's a carry, and to 0 when there isn't
+	//Remember to set VF to carry if overflows
+	cpu->V[0xF] = cpu->V[in.y] > (0xFF - cpu->V[in.x]) ? 1 : 0;
+	cpu->V[in.x] += cpu->V[in.y];
+	cpu->progCounter += 2;
+}
+
+static inline void PROFILED(op_8XY5)(chipCPU *cpu, struct instr in) { // 0x8XY5: VY is subtracted from VX. VF is set to 0 when there's a borrow, and 1 when there isn't
+	cpu->V[0xF] = cpu->V[in.y] > cpu->V[in.x] ? 0 : 1;
+	cpu->V[in.x] -= cpu->V[in.y];
+	cpu->progCounter += 2;
+}
+
+static inline void PROFILED(op_8XY6)(chipCPU *cpu, struct instr in) { // 0x8XY6: Shift VX right by one. VF is set to the value of the least significant bit of VX before the shift
+	byte source = QUIRK(shiftUsesVY) ? cpu->V[in.y] : cpu->V[in.x];
+	cpu->V[0xF] = source & 0x1;
+	cpu->V[in.x] = source >> 1;
+	cpu->progCounter += 2;
+}
+
+static inline void PROFILED(op_8XY7)(chipCPU *cpu, struct instr in) { // 0x8XY7: Set VX to VY minus VX. VF is set to 0 when there's a borrow, and 1 when there isn't
+	cpu->V[0xF] = cpu->V[in.x] > cpu->V[in.y] ? 0 : 1;
+	cpu->V[in.x] = cpu->V[in.y] - cpu->V[in.x];
+	cpu->progCounter += 2;
+}
+
+static inline void PROFILED(op_8XYE)(chipCPU *cpu, struct instr in) { // 0x8XYE: Shift VX left by one. VF is set to the value of the most significant bit of VX before the shift
+	byte source = QUIRK(shiftUsesVY) ? cpu->V[in.y] : cpu->V[in.x];
+	cpu->V[0xF] = source >> 7;
+	cpu->V[in.x] = source << 1;
+	cpu->progCounter += 2;
+}
+
+static inline void PROFILED(op_9XY0)(chipCPU *cpu, struct instr in) { // 0x9XY0: Skip the next instruction if VX doesn't equal VY
+	cpu->progCounter += cpu->V[in.x] != cpu->V[in.y] ? 4 : 2;
+}
+
+static inline void PROFILED(op_ANNN)(chipCPU *cpu, struct instr in) { // 0xANNN: Set I to the address NNN
+	cpu->I = in.nnn;
+	cpu->progCounter += 2;
+}
+
+static inline void PROFILED(op_BNNN)(chipCPU *cpu, struct instr in) { // 0xBNNN: Jump to NNN plus V0 (or XNN plus VX, per quirk profile)
+	cpu->progCounter = in.nnn + cpu->V[QUIRK(jumpUsesVX) ? in.x : 0];
+}
+
+static inline void PROFILED(op_CXNN)(chipCPU *cpu, struct instr in) { // 0xCXNN: Set VX to the result of a bitwise and operation on a random number and NN
+	//Top byte, so all 256 values come up
+	cpu->V[in.x] = (cpu_random(cpu) >> 24) & in.nn;
+	cpu->progCounter += 2;
+}
+
+static inline void PROFILED(op_DXYN)(chipCPU *cpu, struct instr in) { // 0xDXYN: Draw a sprite at coordinate (VX,VY) that has a width of 8px and a height of Npx
+	//Each row of 8 pixels is read as bit-coded starting from mem location I; I value doesn't change after the execution of this instruction.
+	//VF is set to 1 if any screen pixels are flipped from set to unset when the sprite is drawn, and to 0 if that doesn't happen
+	//Sprite rows are rotated into place as 64 bit masks, so wrapping around the right edge is free.
+	//With clipping, they're shifted instead and rows past the bottom are left out.
+	unsigned int x = cpu->V[in.x] % DISPLAY_WIDTH;
+	unsigned int y = QUIRK(clipSprites) ? cpu->V[in.y] % DISPLAY_HEIGHT : cpu->V[in.y];
+	unsigned int height = in.nn & 0x000F;
+	if (QUIRK(clipSprites) && y + height > DISPLAY_HEIGHT) height = DISPLAY_HEIGHT - y;
+	uint64_t collision = 0;
+	
+	for (unsigned int yline = 0; yline < height; yline++) {
+		uint64_t sprite = (uint64_t)cpu->memory[cpu->I + yline] << 56;
+		uint64_t mask = QUIRK(clipSprites) || !x ? sprite >> x : (sprite >> x) | (sprite << (64 - x));
+		unsigned int rowIndex = (y + yline) % DISPLAY_HEIGHT;
+		uint64_t *row = &cpu->display[rowIndex];
+		collision |= *row & mask;
+		*row ^= mask;
+		cpu->dirtyRows |= 1u << rowIndex;
+	}
+	cpu->V[0xF] = collision != 0; //Collision happened
+	
+	cpu->drawFlag = true; //We've altered the display array, therefore set drawflag to true to update the screen
+	cpu->sideEffects++;
+	cpu->progCounter += 2;
+}
+
+static inline void PROFILED(op_EX9E)(chipCPU *cpu, struct instr in) { // 0xEX9E: Skip the next instruction if the key stored in VX is pressed
+	cpu->progCounter += cpu_key_pressed(cpu, cpu->V[in.x]) ? 4 : 2;
+}
+
+static inline void PROFILED(op_EXA1)(chipCPU *cpu, struct instr in) { // 0xEXA1: Skip the next instruction if the key stored in VX isn't pressed
+	cpu->progCounter += cpu_key_pressed(cpu, cpu->V[in.x]) ? 2 : 4;
+}
+
+static inline void PROFILED(op_FX07)(chipCPU *cpu, struct instr in) { // 0xFX07: Set VX to the value of the delay timer
+	cpu_update_timers(cpu);
+	cpu->V[in.x] = cpu->delay_timer;
+	cpu->progCounter += 2;
+}
+
+static inline void PROFILED(op_FX0A)(chipCPU *cpu, struct instr in) { // 0xFX0A: Wait for key press, then store in VX
+	//Don't advance until a key is pressed. With several down, the highest one wins.
+	cpu->keysRead = true;
+	if (cpu->keys) {
+		cpu->V[in.x] = highest_bit(cpu->keys);
+		cpu->progCounter += 2;
+	} else {
+		cpu_idle_key_wait(cpu);
+	}
+}
+
+static inline void PROFILED(op_FX15)(chipCPU *cpu, struct instr in) { // 0xFX15: Set the delay timer to VX
+	cpu_update_timers(cpu);
+	cpu->delay_timer = cpu->V[in.x];
+	cpu->sideEffects++;
+	cpu->progCounter += 2;
+}
+
+static inline void PROFILED(op_FX18)(chipCPU *cpu, struct instr in) { // 0xFX18: Set the sound timer to VX
+	cpu_update_timers(cpu);
+	cpu->sound_timer = cpu->V[in.x];
+	cpu->sideEffects++;
+	cpu->progCounter += 2;
+}
+
+static inline void PROFILED(op_FX1E)(chipCPU *cpu, struct instr in) { // 0xFX1E: Add VX to I
+	cpu->V[0xF] = cpu->I + cpu->V[in.x] > 0xFFF ? 1 : 0; //Overflow
+	cpu->I += cpu->V[in.x];
+	cpu->progCounter += 2;
+}
+
+static inline void PROFILED(op_FX29)(chipCPU *cpu, struct instr in) { // 0xFX29: Set I to the location of the sprite for the character in VX. Characters 0-F in hex are represented by a 4x5 font (mainFontset)
+	cpu->I = cpu->V[in.x] * 0x5;
+	cpu->progCounter += 2;
+}
+
+static inline void PROFILED(op_FX33)(chipCPU *cpu, struct instr in) { // 0xFX33: Store the binary-coded decimal representation of VX at I, I+1 and I+2
+	//Hundreds digit in memory at I, tens digit at I+1, and ones at I+2
+	cpu->memory[cpu->I]	  =  cpu->V[in.x] / 100;
+	cpu->memory[cpu->I + 1] = (cpu->V[in.x] / 10) % 10;
+	cpu->memory[cpu->I + 2] = (cpu->V[in.x] % 100) % 10;
+	cpu->sideEffects++;
+	cpu_invalidate_code(cpu, cpu->I, 3);
+	cpu->progCounter += 2;
+}
+
+static inline void PROFILED(op_FX55)(chipCPU *cpu, struct instr in) { // 0xFX55: Store V0 to VX (Including VX) in memory starting at address I
+	for (int i = 0; i <= in.x; i++) {
+		cpu->memory[cpu->I + i] = cpu->V[i];
+	}
+	cpu_invalidate_code(cpu, cpu->I, in.x + 1);
+	cpu->sideEffects++;
+	if (QUIRK(store) != indexUnchanged) cpu->I += in.x + (QUIRK(store) == indexPlusXPlusOne);
+	cpu->progCounter += 2;
+}
+
+static inline void PROFILED(op_FX65)(chipCPU *cpu, struct instr in) { // 0xFX65: Fill V0 to VX (Including VX) with values from memory starting at address I
+	for (int i = 0; i <= in.x; i++) {
+		cpu->V[i] = cpu->memory[cpu->I + i];
+	}
+	if (QUIRK(load) != indexUnchanged) cpu->I += in.x + (QUIRK(load) == indexPlusXPlusOne);
+	cpu->progCounter += 2;
+}
+
+#undef QUIRK
@@ -0,0 +1,152 @@
+//
+//  overlay.c
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "overlay.h"
+#include "timing.h"
+
+#define BACKGROUND 0xC0000000
+#define TEXT_COLOR 0xFFFFFF00
+#define BAR_COLOR  0xFF00C0FF
+
+//Time between redraws
+#define UPDATE_INTERVAL (NSEC_PER_SEC / 4)
+
+//Each metric gets a line of text and a bar graph under it
+#define ROW_HEIGHT (OVERLAY_HEIGHT / metricCount)
+#define GRAPH_TOP 8
+#define GRAPH_HEIGHT (ROW_HEIGHT - GRAPH_TOP - 2)
+#define MARGIN 4
+#define VALUE_COLUMN (MARGIN + 8 * 4)
+
+static const char *labels[metricCount] = {
+	[metricIPS] = "IPS",
+	[metricFrameTime] = "FRAME",
+	[metricRenderTime] = "RENDER",
+	[metricInputTime] = "INPUT",
+	[metricTimerDrift] = "DRIFT",
+	[metricInputLatency] = "LATENCY",
+};
+
+//3x5 font, one row of three bits per line, most significant bit on the left.
+//Only what the overlay writes is in here.
+static const Uint8 *glyph(char c) {
+	static const Uint8 digits[10][5] = {
+		{7,5,5,5,7}, {2,6,2,2,7}, {7,1,7,4,7}, {7,1,3,1,7}, {5,5,7,1,1},
+		{7,4,7,1,7}, {7,4,7,5,7}, {7,1,1,2,2}, {7,5,7,5,7}, {7,5,7,1,7}
+	};
+	static const Uint8 letters[26][5] = {
+		['A' - 'A'] = {2,5,7,5,5}, ['C' - 'A'] = {7,4,4,4,7}, ['D' - 'A'] = {6,5,5,5,6},
+		['E' - 'A'] = {7,4,6,4,7}, ['F' - 'A'] = {7,4,6,4,4}, ['G' - 'A'] = {7,4,5,5,7},
+		['I' - 'A'] = {7,2,2,2,7}, ['K' - 'A'] = {5,5,6,5,5}, ['L' - 'A'] = {4,4,4,4,7},
+		['M' - 'A'] = {5,7,7,5,5}, ['N' - 'A'] = {6,5,5,5,5}, ['P' - 'A'] = {6,5,6,4,4},
+		['R' - 'A'] = {6,5,6,5,5}, ['S' - 'A'] = {3,4,2,1,6}, ['T' - 'A'] = {7,2,2,2,2},
+		['U' - 'A'] = {5,5,5,5,7}, ['X' - 'A'] = {5,5,2,5,5}, ['Y' - 'A'] = {5,5,2,2,2},
+	};
+	static const Uint8 dot[5] = {0,0,0,0,2};
+	static const Uint8 dash[5] = {0,0,7,0,0};
+	if (c >= '0' && c <= '9') return digits[c - '0'];
+	if (c >= 'A' && c <= 'Z') return letters[c - 'A'];
+	if (c == '.') return dot;
+	if (c == '-') return dash;
+	return NULL;
+}
+
+static void draw_text(struct overlay *o, int x, int y, const char *text) {
+	for (; *text && x + 3 <= OVERLAY_WIDTH; ++text, x += 4) {
+		const Uint8 *rows = glyph(*text);
+		if (!rows) continue;
+		for (int row = 0; row < 5; ++row) {
+			for (int column = 0; column < 3; ++column) {
+				if (rows[row] & (4 >> column)) o->pixels[(y + row) * OVERLAY_WIDTH + x + column] = TEXT_COLOR;
+			}
+		}
+	}
+}
+
+//Instructions per second with K, M or G, times in NS, US or MS
+static void format_value(enum metric which, uint64_t value, char *out, size_t size) {
+	if (which == metricIPS) {
+		if (value >= 1000000000) snprintf(out, size, "%.1fG", value / 1e9);
+		else if (value >= 1000000) snprintf(out, size, "%.1fM", value / 1e6);
+		else if (value >= 1000) snprintf(out, size, "%.1fK", value / 1e3);
+		else snprintf(out, size, "%llu", (unsigned long long)value);
+	} else {
+		if (value >= 1000000) snprintf(out, size, "%.1fMS", value / 1e6);
+		else if (value >= 1000) snprintf(out, size, "%.1fUS", value / 1e3);
+		else snprintf(out, size, "%lluNS", (unsigned long long)value);
+	}
+}
+
+static void draw_metric(struct overlay *o, struct metrics *m, enum metric which, int top) {
+	struct metricSnapshot s;
+	metrics_snapshot(m, which, &s);
+	draw_text(o, MARGIN, top + 2, labels[which]);
+	if (!s.count) {
+		draw_text(o, VALUE_COLUMN, top + 2, "-");
+		return;
+	}
+	char p50[16], p99[16], max[16], line[64];
+	format_value(which, metrics_percentile(&s, 0.5), p50, sizeof(p50));
+	format_value(which, metrics_percentile(&s, 0.99), p99, sizeof(p99));
+	format_value(which, metrics_bucket_value(s.highest), max, sizeof(max));
+	snprintf(line, sizeof(line), "P50 %-8s P99 %-8s MAX %s", p50, p99, max);
+	draw_text(o, VALUE_COLUMN, top + 2, line);
+	
+	//One bar per bucket from the lowest to the highest in use, as wide as fits
+	int span = s.highest - s.lowest + 1;
+	int width = (OVERLAY_WIDTH - 2 * MARGIN) / span;
+	if (width > 4) width = 4;
+	if (width < 1) width = 1;
+	unsigned int tallest = 0;
+	for (int b = s.lowest; b <= s.highest; ++b) {
+		if (s.buckets[b] > tallest) tallest = s.buckets[b];
+	}
+	for (int b = s.lowest; b <= s.highest; ++b) {
+		int x = MARGIN + (b - s.lowest) * width;
+		if (x + width > OVERLAY_WIDTH - MARGIN) break;
+		//Anything in a bucket gets at least a pixel, so rare outliers still show
+		int height = s.buckets[b] ? 1 + (int)((unsigned long long)s.buckets[b] * (GRAPH_HEIGHT - 1) / tallest) : 0;
+		for (int y = GRAPH_HEIGHT - height; y < GRAPH_HEIGHT; ++y) {
+			for (int dx = 0; dx < width; ++dx) {
+				o->pixels[(top + GRAPH_TOP + y) * OVERLAY_WIDTH + x + dx] = BAR_COLOR;
+			}
+		}
+	}
+}
+
+bool overlay_init(struct overlay *o, SDL_Renderer *sdl) {
+	o->texture = SDL_CreateTexture(sdl, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, OVERLAY_WIDTH, OVERLAY_HEIGHT);
+	if (o->texture == NULL) {
+		printf("Overlay texture couldn't be created, error %s\n", SDL_GetError());
+		return false;
+	}
+	SDL_SetTextureBlendMode(o->texture, SDL_BLENDMODE_BLEND);
+	o->nextUpdate = 0;
+	return true;
+}
+
+bool overlay_update(struct overlay *o, struct metrics *m) {
+	long long now = time_now_ns();
+	if (now < o->nextUpdate) return false;
+	o->nextUpdate = now + UPDATE_INTERVAL;
+	for (int i = 0; i < OVERLAY_WIDTH * OVERLAY_HEIGHT; ++i) {
+		o->pixels[i] = BACKGROUND;
+	}
+	for (int i = 0; i < metricCount; ++i) {
+		draw_metric(o, m, i, i * ROW_HEIGHT);
+	}
+	SDL_UpdateTexture(o->texture, NULL, o->pixels, OVERLAY_WIDTH * sizeof(Uint32));
+	return true;
+}
+
+void overlay_destroy(struct overlay *o) {
+	if (o->texture != NULL) {
+		SDL_DestroyTexture(o->texture);
+		o->texture = NULL;
+	}
+}
@@ -0,0 +1,34 @@
+//
+//  overlay.h
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#ifndef overlay_h
+#define overlay_h
+
+#include <SDL2/SDL.h>
+#include "metrics.h"
+
+//On-screen metrics, drawn over the display. Every metric gets a line with its median, p99 and
+//worst case, and a bar graph of its histogram. Drawn in software into a texture 4x the size of
+//the CHIP-8 display, with a small built in font, and redrawn a few times a second.
+#define OVERLAY_WIDTH 256
+#define OVERLAY_HEIGHT 128
+
+struct overlay {
+	SDL_Texture *texture;
+	Uint32 pixels[OVERLAY_WIDTH * OVERLAY_HEIGHT];
+	long long nextUpdate;
+};
+
+bool overlay_init(struct overlay *o, SDL_Renderer *sdl);
+
+//Redraw the texture from m, if it's been long enough since the last time. Returns true if it did.
+bool overlay_update(struct overlay *o, struct metrics *m);
+
+void overlay_destroy(struct overlay *o);
+
+#endif /* overlay_h */
@@ -0,0 +1,223 @@
+//
+//  profile.c
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "profile.h"
+
+#ifdef CPU_PROFILE
+
+#include <stdlib.h>
+#include <string.h>
+
+//Addresses listed in the report
+#define REPORT_HOTTEST 20
+//Longest loop, in instructions, that counts as waiting on the delay timer without being fast-forwarded
+#define WAIT_LOOP_LENGTH 8
+
+struct ranked {
+	int key;
+	unsigned long long count;
+};
+
+static int by_count(const void *a, const void *b) {
+	const struct ranked *ra = a, *rb = b;
+	if (ra->count != rb->count) return ra->count < rb->count ? 1 : -1;
+	return ra->key - rb->key;
+}
+
+static int new_node(struct profiler *p, int parent, unsigned short entry) {
+	struct profileNode *node = &p->nodes[p->nodeCount];
+	memset(node, 0, sizeof(*node));
+	node->entry = entry;
+	node->parent = parent;
+	node->firstChild = -1;
+	node->nextSibling = -1;
+	if (parent >= 0) {
+		node->nextSibling = p->nodes[parent].firstChild;
+		p->nodes[parent].firstChild = p->nodeCount;
+	}
+	return p->nodeCount++;
+}
+
+//The node for entry called from parent, made on the first call
+static int child(struct profiler *p, int parent, unsigned short entry) {
+	for (int n = p->nodes[parent].firstChild; n >= 0; n = p->nodes[n].nextSibling) {
+		if (p->nodes[n].entry == entry) return n;
+	}
+	if (p->nodeCount == PROFILE_MAX_NODES) return parent;
+	return new_node(p, parent, entry);
+}
+
+bool profile_start(chipCPU *cpu) {
+	profile_stop(cpu);
+	struct profiler *p = calloc(1, sizeof(*p));
+	if (!p) return false;
+	//Whatever is running now is the root, calls are followed from here
+	p->node = new_node(p, -1, cpu->progCounter);
+	p->depth = cpu->stackPointer;
+	for (int d = 0; d <= PROFILE_MAX_DEPTH; ++d) p->path[d] = p->node;
+	cpu->profile = p;
+	return true;
+}
+
+void profile_stop(chipCPU *cpu) {
+	free(cpu->profile);
+	cpu->profile = NULL;
+}
+
+void profile_stack_changed(struct profiler *p, unsigned short depth, unsigned short pc) {
+	//A call enters a subroutine at pc. Returns, or anything else that lowered the stack pointer, just go back up.
+	for (int d = p->depth + 1; d <= depth && d <= PROFILE_MAX_DEPTH; ++d) {
+		p->path[d] = child(p, p->path[d - 1], pc);
+	}
+	p->depth = depth;
+	p->node = p->path[depth < PROFILE_MAX_DEPTH ? depth : PROFILE_MAX_DEPTH];
+}
+
+void profile_idle(chipCPU *cpu, unsigned short pc, unsigned long long skipped) {
+	struct profiler *p = cpu->profile;
+	p->idleCounts[pc & 0xFFF] += skipped;
+	//FX0A doesn't advance until a key is down, so the PC still points at it
+	if (opHandlerTable[cpu->currentOP] == OP_FX0A) {
+		p->nodes[p->node].keyWaitCycles += skipped;
+	} else {
+		p->nodes[p->node].idleCycles += skipped;
+	}
+}
+
+void profile_frame(struct profiler *p) {
+	unsigned long long draws = p->opCounts[OP_DXYN] - p->lastDraws;
+	unsigned long long clears = p->opCounts[OP_00E0] - p->lastClears;
+	if (draws > p->maxDraws) p->maxDraws = draws;
+	if (clears > p->maxClears) p->maxClears = clears;
+	p->lastDraws = p->opCounts[OP_DXYN];
+	p->lastClears = p->opCounts[OP_00E0];
+	p->frames++;
+}
+
+static unsigned short opcode_at(chipCPU *cpu, int pc) {
+	return cpu->memory[pc & 0xFFF] << 8 | cpu->memory[(pc + 1) & 0xFFF];
+}
+
+//What kept the machine waiting at pc, and the instructions it ran doing so.
+//NULL if it doesn't look like it was waiting on anything.
+static const char *describe_wait(chipCPU *cpu, int pc, int *start, unsigned long long *run) {
+	struct profiler *p = cpu->profile;
+	unsigned short op = opcode_at(cpu, pc);
+	*start = pc;
+	*run = p->pcCounts[pc];
+	if (cpu_decode_handler(op) == OP_FX0A) return *run ? "FX0A key wait" : NULL;
+	if (cpu_decode_handler(op) != OP_1NNN || (op & 0x0FFF) > pc) return p->idleCounts[pc] ? "loop" : NULL;
+	//Backward jump, the loop is everything from its target up to here
+	bool readsDelay = false;
+	*start = op & 0x0FFF;
+	*run = 0;
+	for (int a = *start; a <= pc; a += 2) {
+		*run += p->pcCounts[a];
+		if (cpu_decode_handler(opcode_at(cpu, a)) == OP_FX07) readsDelay = true;
+	}
+	//Loops the idle detector skipped are waits whatever they are, others only if they're short and read the timer
+	if (p->idleCounts[pc]) return readsDelay ? "delay timer loop" : "loop";
+	return readsDelay && *run && pc - *start < WAIT_LOOP_LENGTH * 2 ? "delay timer loop" : NULL;
+}
+
+static void report_addresses(chipCPU *cpu, FILE *out, unsigned long long total) {
+	struct profiler *p = cpu->profile;
+	struct ranked hottest[MEMORY_SIZE];
+	int count = 0;
+	for (int pc = 0; pc < MEMORY_SIZE; ++pc) {
+		unsigned long long cycles = p->pcCounts[pc] + p->idleCounts[pc];
+		if (cycles) hottest[count++] = (struct ranked){ pc, cycles };
+	}
+	qsort(hottest, count, sizeof(*hottest), by_count);
+	fprintf(out, "Hottest addresses, by cycles run and fast-forwarded there:\n");
+	fprintf(out, "  PC     Opcode          Run      Skipped   Share\n");
+	for (int i = 0; i < count && i < REPORT_HOTTEST; ++i) {
+		int pc = hottest[i].key;
+		unsigned short op = opcode_at(cpu, pc);
+		fprintf(out, "  0x%03X  0x%04X %-7s %12llu %12llu  %5.1f%%\n", pc, op, opPatterns[cpu_decode_handler(op)],
+				p->pcCounts[pc], p->idleCounts[pc], 100.0 * hottest[i].count / total);
+	}
+}
+
+static void report_opcodes(struct profiler *p, FILE *out, unsigned long long instructions) {
+	struct ranked ops[OP_COUNT];
+	int count = 0;
+	for (int h = 0; h < OP_COUNT; ++h) {
+		if (p->opCounts[h]) ops[count++] = (struct ranked){ h, p->opCounts[h] };
+	}
+	qsort(ops, count, sizeof(*ops), by_count);
+	fprintf(out, "Opcodes, by instructions run:\n");
+	for (int i = 0; i < count; ++i) {
+		fprintf(out, "  %-7s %12llu  %5.1f%%  %8.2f a frame\n", opPatterns[ops[i].key], ops[i].count,
+				100.0 * ops[i].count / instructions, p->frames ? (double)ops[i].count / p->frames : 0);
+	}
+	fprintf(out, "Per frame: DXYN %.2f on average and at most %llu, 00E0 %.2f on average and at most %llu\n",
+			p->frames ? (double)p->opCounts[OP_DXYN] / p->frames : 0, p->maxDraws,
+			p->frames ? (double)p->opCounts[OP_00E0] / p->frames : 0, p->maxClears);
+}
+
+static void report_waits(chipCPU *cpu, FILE *out, unsigned long long total) {
+	struct profiler *p = cpu->profile;
+	struct ranked waits[MEMORY_SIZE];
+	int count = 0;
+	for (int pc = 0; pc < MEMORY_SIZE; ++pc) {
+		int start;
+		unsigned long long run;
+		if (describe_wait(cpu, pc, &start, &run)) waits[count++] = (struct ranked){ pc, run + p->idleCounts[pc] };
+	}
+	if (!count) return;
+	qsort(waits, count, sizeof(*waits), by_count);
+	fprintf(out, "Waiting, by cycles run and fast-forwarded:\n");
+	for (int i = 0; i < count; ++i) {
+		int pc = waits[i].key;
+		int start;
+		unsigned long long run;
+		const char *what = describe_wait(cpu, pc, &start, &run);
+		fprintf(out, "  0x%03X-0x%03X %-16s %12llu run %12llu skipped  %5.1f%%\n", start, pc, what,
+				run, p->idleCounts[pc], 100.0 * waits[i].count / total);
+	}
+}
+
+//One line per call path, frames separated by ; and weighted by cycles, as flamegraph.pl and friends read them.
+//Fast-forwarded cycles show up as a frame of their own under the subroutine that was waiting.
+static void write_stacks(struct profiler *p, FILE *out, int n, char *path, size_t length) {
+	struct profileNode *node = &p->nodes[n];
+	length += snprintf(path + length, 8, "%s0x%03X", length ? ";" : "", node->entry);
+	if (node->cycles) fprintf(out, "%s %llu\n", path, node->cycles);
+	if (node->idleCycles) fprintf(out, "%s;[idle loop] %llu\n", path, node->idleCycles);
+	if (node->keyWaitCycles) fprintf(out, "%s;[FX0A key wait] %llu\n", path, node->keyWaitCycles);
+	for (int c = node->firstChild; c >= 0; c = p->nodes[c].nextSibling) {
+		write_stacks(p, out, c, path, length);
+	}
+}
+
+void profile_report(chipCPU *cpu, FILE *out, FILE *stacks) {
+	struct profiler *p = cpu->profile;
+	unsigned long long instructions = 0;
+	unsigned long long skipped = 0;
+	for (int pc = 0; pc < MEMORY_SIZE; ++pc) {
+		instructions += p->pcCounts[pc];
+		skipped += p->idleCounts[pc];
+	}
+	fprintf(out, "Profile: %llu instructions run over %llu frames, and %llu cycles fast-forwarded\n",
+			instructions, p->frames, skipped);
+	if (instructions + skipped == 0) return;
+	report_addresses(cpu, out, instructions + skipped);
+	report_opcodes(p, out, instructions);
+	report_waits(cpu, out, instructions + skipped);
+	if (p->nodeCount == PROFILE_MAX_NODES) {
+		fprintf(out, "More than %d call paths, the rest are counted against their callers\n", PROFILE_MAX_NODES);
+	}
+	if (stacks) {
+		char path[(PROFILE_MAX_DEPTH + 1) * 6 + 1];
+		path[0] = '\0';
+		write_stacks(p, stacks, 0, path, 0);
+	}
+}
+
+#endif
@@ -0,0 +1,95 @@
+//
+//  profile.h
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#ifndef profile_h
+#define profile_h
+
+#include <stdio.h>
+#include "CPU.h"
+#include "decode.h"
+
+//Hot-spot profiler, built in with -DCPU_PROFILE. It counts every instruction run by address and by
+//opcode, and every cycle the idle detector fast-forwards by the loop or FX0A it skipped for.
+//Subroutines are followed through 2NNN and 00EE, so cycles can also be written out as collapsed
+//stacks for flamegraph tools. Profiling runs everything through the interpreter.
+//Without CPU_PROFILE, PROFILE_*() compile to nothing and the interpreter doesn't look at it at all.
+
+#ifdef CPU_PROFILE
+
+//Calls deeper than the CHIP-8 stack are counted against the deepest one
+#define PROFILE_MAX_DEPTH 16
+//Distinct call paths kept, ones past this are counted against their caller
+#define PROFILE_MAX_NODES 4096
+
+//A subroutine, as reached through one particular chain of calls
+struct profileNode {
+	unsigned short entry; //Address it was called at, the root is where the ROM started
+	int parent;
+	int firstChild;
+	int nextSibling;
+	unsigned long long cycles; //Instructions run in it, not counting the ones it called
+	unsigned long long idleCycles; //Fast-forwarded loop iterations
+	unsigned long long keyWaitCycles; //Fast-forwarded FX0A waits
+};
+
+struct profiler {
+	unsigned long long pcCounts[MEMORY_SIZE]; //Instructions run at each address
+	unsigned long long idleCounts[MEMORY_SIZE]; //Cycles fast-forwarded at each address
+	unsigned long long opCounts[OP_COUNT];
+	unsigned long long frames;
+	//DXYN and 00E0 counts when the last frame ended, and the most of each seen in one frame
+	unsigned long long lastDraws, lastClears;
+	unsigned long long maxDraws, maxClears;
+	
+	//Call tree, nodes[0] is the root
+	struct profileNode nodes[PROFILE_MAX_NODES];
+	int nodeCount;
+	//Stack pointer as of the last instruction, the node for each level of it, and the one running now
+	unsigned short depth;
+	int path[PROFILE_MAX_DEPTH + 1];
+	int node;
+};
+
+//Start profiling from here on, discarding any earlier profile. Returns false if out of memory.
+bool profile_start(chipCPU *cpu);
+
+//Print the report to out, and the call tree as collapsed stacks to stacks unless it's NULL
+void profile_report(chipCPU *cpu, FILE *out, FILE *stacks);
+
+//Stop profiling and free the counters
+void profile_stop(chipCPU *cpu);
+
+//Follow the stack pointer to the subroutine now running, see profile_instruction()
+void profile_stack_changed(struct profiler *p, unsigned short depth, unsigned short pc);
+//Count the cycles cpu_idle_jump() or cpu_idle_key_wait() skipped at pc
+void profile_idle(chipCPU *cpu, unsigned short pc, unsigned long long skipped);
+//Frame boundary, for the per frame DXYN and 00E0 counts
+void profile_frame(struct profiler *p);
+
+//Count the instruction just fetched. Called for every one, so this is all it does.
+static inline void profile_instruction(chipCPU *cpu) {
+	struct profiler *p = cpu->profile;
+	if (cpu->stackPointer != p->depth) profile_stack_changed(p, cpu->stackPointer, cpu->progCounter);
+	p->pcCounts[cpu->progCounter & 0xFFF]++;
+	p->opCounts[opHandlerTable[cpu->currentOP]]++;
+	p->nodes[p->node].cycles++;
+}
+
+#define PROFILE_INSTRUCTION(cpu) if ((cpu)->profile) profile_instruction(cpu)
+#define PROFILE_IDLE(cpu, pc, skipped) if ((cpu)->profile) profile_idle(cpu, pc, skipped)
+#define PROFILE_FRAME(cpu) if ((cpu)->profile) profile_frame((cpu)->profile)
+
+#else
+
+#define PROFILE_INSTRUCTION(cpu)
+#define PROFILE_IDLE(cpu, pc, skipped)
+#define PROFILE_FRAME(cpu)
+
+#endif
+
+#endif /* profile_h */
@@ -0,0 +1,66 @@
+//
+//  quirks.h
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#ifndef quirks_h
+#define quirks_h
+
+#include <stdbool.h>
+#include <string.h>
+
+//Interpreters over the years disagree on what a few instructions do, and ROMs were written
+//against one or the other. A profile picks one behaviour for each of them.
+//CPU.c builds a separate interpreter for every profile (see interpreter.h), so the choice
+//costs nothing per instruction.
+enum quirkProfile {
+	quirksLegacy, //What this emulator always did, the default
+	quirksVIP,	  //COSMAC VIP, the original interpreter
+	quirksCHIP48, //CHIP-48 on the HP-48
+	quirksSCHIP,  //SUPER-CHIP 1.1
+	quirksModern, //What most ROMs written in the last decade expect
+	quirkProfileCount
+};
+
+//How FX55 and FX65 leave I
+enum quirkIndex {
+	indexUnchanged,
+	indexPlusX,		 //I += X, CHIP-48 being off by one
+	indexPlusXPlusOne //I += X + 1, like the loop left it
+};
+
+struct quirks {
+	const char *name;
+	bool shiftUsesVY;	   //8XY6/8XYE shift VY into VX, instead of shifting VX in place
+	bool logicResetsVF;	   //8XY1/8XY2/8XY3 clear VF
+	enum quirkIndex store; //FX55
+	enum quirkIndex load;  //FX65
+	bool jumpUsesVX;	   //BNNN jumps to XNN + VX instead of NNN + V0
+	bool clipSprites;	   //DXYN clips sprites at the screen edges instead of wrapping them around
+};
+
+//Indexed by enum quirkProfile. Reads with a constant index fold away, which is what
+//lets the same handler source compile into a specialised one for each profile.
+static const struct quirks quirkProfiles[quirkProfileCount] = {
+	[quirksLegacy] = { "legacy", false, false, indexPlusXPlusOne, indexUnchanged,	 false, false },
+	[quirksVIP]	   = { "vip",	 true,  true,  indexPlusXPlusOne, indexPlusXPlusOne, false, true },
+	[quirksCHIP48] = { "chip48", false, false, indexPlusX,		  indexPlusX,		 true,  true },
+	[quirksSCHIP]  = { "schip",	 false, false, indexUnchanged,	  indexUnchanged,	 true,  true },
+	[quirksModern] = { "modern", false, false, indexPlusXPlusOne, indexPlusXPlusOne, false, false },
+};
+
+//Profile by name, as in the table above. Returns false if there's no such profile.
+static inline bool quirks_find(const char *name, enum quirkProfile *profile) {
+	for (int p = 0; p < quirkProfileCount; ++p) {
+		if (strcmp(quirkProfiles[p].name, name) == 0) {
+			*profile = (enum quirkProfile)p;
+			return true;
+		}
+	}
+	return false;
+}
+
+#endif /* quirks_h */
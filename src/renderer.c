@@ -0,0 +1,70 @@
+//
+//  renderer.c
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "renderer.h"
+
+#define PIXEL_ON  0xFFFFFFFF
+#define PIXEL_OFF 0xFF000000
+
+bool renderer_init(struct renderer *r, SDL_Renderer *sdl) {
+	r->sdl = sdl;
+	r->texture = SDL_CreateTexture(sdl, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, DISPLAY_WIDTH, DISPLAY_HEIGHT);
+	if (r->texture == NULL) {
+		printf("Texture couldn't be created, error %s\n", SDL_GetError());
+		return false;
+	}
+	//Keep the 2:1 aspect ratio when the window is resized or fullscreen
+	SDL_RenderSetLogicalSize(sdl, DISPLAY_WIDTH, DISPLAY_HEIGHT);
+	
+	//Start from a blank texture
+	memset(r->shown, 0, sizeof(r->shown));
+	for (int i = 0; i < DISPLAY_WIDTH * DISPLAY_HEIGHT; ++i) {
+		r->pixels[i] = PIXEL_OFF;
+	}
+	SDL_UpdateTexture(r->texture, NULL, r->pixels, DISPLAY_WIDTH * sizeof(Uint32));
+	r->needsPresent = true;
+	r->overlay = NULL;
+	return true;
+}
+
+void renderer_update(struct renderer *r, const uint64_t *rows, uint32_t dirtyRows) {
+	int runStart = -1;
+	for (int y = 0; y <= DISPLAY_HEIGHT; ++y) {
+		bool changed = y < DISPLAY_HEIGHT && (dirtyRows & (1u << y)) && rows[y] != r->shown[y];
+		if (changed) {
+			Uint32 *pixel = &r->pixels[y * DISPLAY_WIDTH];
+			for (int x = 0; x < DISPLAY_WIDTH; ++x) {
+				pixel[x] = (rows[y] & (0x8000000000000000ULL >> x)) ? PIXEL_ON : PIXEL_OFF;
+			}
+			r->shown[y] = rows[y];
+			if (runStart < 0) runStart = y;
+		} else if (runStart >= 0) {
+			//Upload each run of adjacent changed rows in one go
+			SDL_Rect rect = { 0, runStart, DISPLAY_WIDTH, y - runStart };
+			SDL_UpdateTexture(r->texture, &rect, &r->pixels[runStart * DISPLAY_WIDTH], DISPLAY_WIDTH * sizeof(Uint32));
+			r->needsPresent = true;
+			runStart = -1;
+		}
+	}
+}
+
+void renderer_present(struct renderer *r) {
+	if (!r->needsPresent) return;
+	SDL_RenderClear(r->sdl);
+	SDL_RenderCopy(r->sdl, r->texture, NULL, NULL);
+	if (r->overlay) SDL_RenderCopy(r->sdl, r->overlay, NULL, NULL);
+	SDL_RenderPresent(r->sdl);
+	r->needsPresent = false;
+}
+
+void renderer_destroy(struct renderer *r) {
+	if (r->texture != NULL) {
+		SDL_DestroyTexture(r->texture);
+		r->texture = NULL;
+	}
+}
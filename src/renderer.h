@@ -0,0 +1,39 @@
+//
+//  renderer.h
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#ifndef renderer_h
+#define renderer_h
+
+#include <SDL2/SDL.h>
+#include "CPU.h"
+
+//Keeps the CHIP-8 display in a single 64x32 streaming texture, which gets scaled
+//to the window with one SDL_RenderCopy. Only rows that changed are uploaded.
+struct renderer {
+	SDL_Renderer *sdl;
+	SDL_Texture *texture;
+	//What the texture currently holds, so rows that were drawn and then undrawn can be skipped
+	uint64_t shown[DISPLAY_HEIGHT];
+	Uint32 pixels[DISPLAY_WIDTH * DISPLAY_HEIGHT];
+	//Set when the texture changed since the last present
+	bool needsPresent;
+	//Drawn over the display when it's set, see overlay.h
+	SDL_Texture *overlay;
+};
+
+bool renderer_init(struct renderer *r, SDL_Renderer *sdl);
+
+//Upload the rows set in dirtyRows (bit n = row n) to the texture
+void renderer_update(struct renderer *r, const uint64_t *rows, uint32_t dirtyRows);
+
+//Present, if anything changed since the last call
+void renderer_present(struct renderer *r);
+
+void renderer_destroy(struct renderer *r);
+
+#endif /* renderer_h */
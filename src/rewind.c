@@ -0,0 +1,225 @@
+//
+//  rewind.c
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "rewind.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Unchanged bytes shorter than this between two changed ones are folded into one run,
+//a run header costs 4 bytes
+#define RUN_GAP 4
+
+//Average record size the index is sized for. Smaller records than this just run out of index first.
+#define BYTES_PER_ENTRY 128
+
+bool rewind_init(struct rewind_buffer *r, size_t budget) {
+	memset(r, 0, sizeof(*r));
+	r->stateSize = chip8_state_size();
+	r->maxEntries = budget / BYTES_PER_ENTRY;
+	size_t indexSize = r->maxEntries * sizeof(struct rewind_entry);
+	//Has to hold at least one keyframe, or nothing can ever be recorded
+	if (budget < indexSize + r->stateSize || r->maxEntries < 1) return false;
+	r->capacity = budget - indexSize;
+	r->data = malloc(r->capacity);
+	r->entries = malloc(indexSize);
+	r->keyframe = malloc(r->stateSize);
+	r->state = malloc(r->stateSize);
+	//Worst case delta, a run header per changed byte would be bigger than a keyframe, which is used instead
+	r->delta = malloc(r->stateSize);
+	if (!r->data || !r->entries || !r->keyframe || !r->state || !r->delta) {
+		rewind_destroy(r);
+		return false;
+	}
+	return true;
+}
+
+void rewind_destroy(struct rewind_buffer *r) {
+	free(r->data);
+	free(r->entries);
+	free(r->keyframe);
+	free(r->state);
+	free(r->delta);
+	memset(r, 0, sizeof(*r));
+}
+
+static struct rewind_entry *entry(const struct rewind_buffer *r, unsigned long long seq) {
+	return &r->entries[seq % r->maxEntries];
+}
+
+static void put16(unsigned char *p, uint16_t value) {
+	p[0] = value;
+	p[1] = value >> 8;
+}
+
+static uint16_t get16(const unsigned char *p) {
+	return p[0] | p[1] << 8;
+}
+
+//Runs of bytes that differ between key and state: u16 unchanged bytes since the last run, u16 run length,
+//then the run XORed with the keyframe. Returns the delta's size, or 0 if it wouldn't be smaller than a keyframe.
+static size_t encode_delta(const unsigned char *key, const unsigned char *state, size_t size, unsigned char *out, size_t outSize) {
+	size_t used = 0;
+	size_t pos = 0;
+	while (pos < size) {
+		size_t start = pos;
+		while (start < size && key[start] == state[start]) start++;
+		if (start == size) break;
+		size_t end = start + 1;
+		while (end < size) {
+			if (key[end] != state[end]) {
+				end++;
+				continue;
+			}
+			size_t gap = end;
+			while (gap < size && gap - end < RUN_GAP && key[gap] == state[gap]) gap++;
+			if (gap == size || gap - end == RUN_GAP) break;
+			end = gap;
+		}
+		size_t length = end - start;
+		if (used + 4 + length >= outSize) return 0;
+		put16(out + used, start - pos);
+		put16(out + used + 2, length);
+		for (size_t i = 0; i < length; ++i) {
+			out[used + 4 + i] = key[start + i] ^ state[start + i];
+		}
+		used += 4 + length;
+		pos = end;
+	}
+	return used;
+}
+
+static void apply_delta(unsigned char *state, const unsigned char *delta, size_t deltaSize) {
+	size_t pos = 0;
+	size_t used = 0;
+	while (used < deltaSize) {
+		pos += get16(delta + used);
+		uint16_t length = get16(delta + used + 2);
+		for (uint16_t i = 0; i < length; ++i) {
+			state[pos + i] ^= delta[used + 4 + i];
+		}
+		pos += length;
+		used += 4 + length;
+	}
+}
+
+//Drop the oldest keyframe and every delta taken against it
+static void evict_oldest(struct rewind_buffer *r) {
+	unsigned long long key = entry(r, r->oldest)->keyframe;
+	while (r->oldest < r->next && entry(r, r->oldest)->keyframe == key) r->oldest++;
+	if (r->oldest == r->next) {
+		r->head = 0;
+		r->haveKeyframe = false;
+	} else if (r->haveKeyframe && r->keyframeSeq == key) {
+		r->haveKeyframe = false;
+	}
+}
+
+//Find room for size bytes after the newest record, evicting old frames until there is
+static size_t allocate(struct rewind_buffer *r, size_t size) {
+	for (;;) {
+		if (r->oldest == r->next) {
+			r->head = 0;
+			return 0;
+		}
+		if (r->next - r->oldest < r->maxEntries) {
+			size_t tail = entry(r, r->oldest)->offset;
+			bool wrapped = entry(r, r->next - 1)->offset < tail;
+			if (!wrapped) {
+				//Records run from tail to head, free space is past head and before tail
+				if (r->capacity - r->head >= size) return r->head;
+				if (tail >= size) return 0;
+			} else if (tail - r->head >= size) {
+				//Records run from tail to the end and from the start to head
+				return r->head;
+			}
+		}
+		evict_oldest(r);
+	}
+}
+
+void rewind_record(struct rewind_buffer *r, struct chip8 *c) {
+	chip8_save_state(c, r->state);
+	
+	//Keyframe when it's time for one, or when a delta would be no smaller
+	size_t size = 0;
+	bool keyframe = !r->haveKeyframe || r->next - r->keyframeSeq >= REWIND_KEYFRAME_INTERVAL;
+	if (!keyframe) {
+		size = encode_delta(r->keyframe, r->state, r->stateSize, r->delta, r->stateSize);
+		keyframe = size == 0;
+	}
+	if (keyframe) size = r->stateSize;
+	
+	size_t offset = allocate(r, size);
+	//Making room can take out the keyframe this delta was against
+	if (!keyframe && !r->haveKeyframe) {
+		keyframe = true;
+		size = r->stateSize;
+		offset = allocate(r, size);
+	}
+	
+	struct rewind_entry *e = entry(r, r->next);
+	e->offset = offset;
+	e->size = (uint32_t)size;
+	if (keyframe) {
+		memcpy(r->data + offset, r->state, size);
+		memcpy(r->keyframe, r->state, size);
+		r->haveKeyframe = true;
+		r->keyframeSeq = r->next;
+		r->keyframes++;
+	} else {
+		memcpy(r->data + offset, r->delta, size);
+		r->deltas++;
+		r->deltaBytes += size;
+	}
+	e->keyframe = r->keyframeSeq;
+	r->head = offset + size;
+	r->next++;
+}
+
+bool rewind_step_back(struct rewind_buffer *r, struct chip8 *c) {
+	if (r->oldest == r->next) return false;
+	unsigned long long seq = --r->next;
+	struct rewind_entry *e = entry(r, seq);
+	struct rewind_entry *key = entry(r, e->keyframe);
+	memcpy(r->state, r->data + key->offset, r->stateSize);
+	if (e->keyframe != seq) {
+		apply_delta(r->state, r->data + e->offset, e->size);
+	}
+	//The state's CRC catches anything that went wrong above
+	int result = chip8_load_state(c, r->state, r->stateSize);
+	
+	//New frames carry on from here, against the keyframe this one belonged to
+	if (e->keyframe == seq) {
+		r->haveKeyframe = false;
+		if (r->next > r->oldest) {
+			unsigned long long previous = entry(r, seq - 1)->keyframe;
+			memcpy(r->keyframe, r->data + entry(r, previous)->offset, r->stateSize);
+			r->keyframeSeq = previous;
+			r->haveKeyframe = true;
+		}
+	}
+	struct rewind_entry *newest = entry(r, r->next - 1);
+	r->head = r->oldest == r->next ? 0 : newest->offset + newest->size;
+	return result == 0;
+}
+
+unsigned long long rewind_frames(const struct rewind_buffer *r) {
+	return r->next - r->oldest;
+}
+
+void rewind_print_stats(const struct rewind_buffer *r) {
+	unsigned long long frames = rewind_frames(r);
+	size_t used = 0;
+	for (unsigned long long seq = r->oldest; seq < r->next; ++seq) {
+		used += entry(r, seq)->size;
+	}
+	printf("Rewind: %llu frames (%.1fs) in %.1fKB of %.1fKB, %llu keyframes, deltas average %.0f bytes\n",
+		   frames, frames / 60.0, used / 1024.0, r->capacity / 1024.0, r->keyframes,
+		   r->deltas ? (double)r->deltaBytes / r->deltas : 0);
+}
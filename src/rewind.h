@@ -0,0 +1,79 @@
+//
+//  rewind.h
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#ifndef rewind_h
+#define rewind_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "chip8.h"
+
+//Rewind history, a save state per frame in a fixed amount of memory.
+//Every so often a frame is kept whole as a keyframe. The frames in between are kept as the runs of
+//bytes that differ from that keyframe, XORed against it. Deltas only ever refer to their keyframe,
+//so any frame comes back with one copy and one pass over its delta, however far back it is.
+//When the memory runs out, the oldest keyframe goes along with the deltas that refer to it.
+
+//Frames between keyframes
+#define REWIND_KEYFRAME_INTERVAL 60
+
+//Memory front ends give it unless told otherwise
+#define REWIND_DEFAULT_BUDGET (16 * 1024 * 1024)
+
+//Where a frame's record lives in the data ring
+struct rewind_entry {
+	size_t offset;
+	uint32_t size;
+	unsigned long long keyframe; //Sequence number of its keyframe, its own if it is one
+};
+
+struct rewind_buffer {
+	//Records, written one after another and wrapping around to the start
+	unsigned char *data;
+	size_t capacity;
+	size_t head; //Where the next record goes
+	
+	//Frame index, also a ring. Sequence numbers count up forever, entry n is at n % maxEntries.
+	struct rewind_entry *entries;
+	unsigned long long maxEntries;
+	unsigned long long oldest;
+	unsigned long long next;
+	
+	//The keyframe new deltas are taken against, and scratch space for encoding and decoding
+	size_t stateSize;
+	unsigned char *keyframe;
+	unsigned char *state;
+	unsigned char *delta;
+	bool haveKeyframe;
+	unsigned long long keyframeSeq;
+	
+	//Stats
+	unsigned long long keyframes;
+	unsigned long long deltas;
+	unsigned long long deltaBytes;
+};
+
+//Set up a rewind buffer taking budget bytes in total, records and index both. Returns false if out of memory.
+bool rewind_init(struct rewind_buffer *r, size_t budget);
+void rewind_destroy(struct rewind_buffer *r);
+
+//Record the machine as it is now, as the newest frame. Front ends call this right before running each frame,
+//so stepping back once goes back one frame.
+void rewind_record(struct rewind_buffer *r, struct chip8 *c);
+
+//Put the machine back to the newest recorded frame and forget it. Returns false if there's nothing left.
+bool rewind_step_back(struct rewind_buffer *r, struct chip8 *c);
+
+//Frames that can currently be stepped back through
+unsigned long long rewind_frames(const struct rewind_buffer *r);
+
+//Frames held, memory used and the keyframe to delta ratio
+void rewind_print_stats(const struct rewind_buffer *r);
+
+#endif /* rewind_h */
@@ -0,0 +1,40 @@
+//
+//  rng.h
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#ifndef rng_h
+#define rng_h
+
+#include <stdint.h>
+
+//PCG32 (XSH-RR) random numbers for CXNN, kept per machine so instances never share or lock anything.
+//The increment picks one of 2^63 streams. Streams are separate sequences, not offsets into one,
+//so machines given the same seed and different streams never draw the same numbers in the same order.
+
+#define RNG_MULTIPLIER 6364136223846793005ULL
+
+//Seed machines start out on, with stream 0
+#define RNG_DEFAULT_SEED 0x2545F491
+
+static inline uint32_t rng_next(uint64_t *state, uint64_t increment) {
+	uint64_t old = *state;
+	*state = old * RNG_MULTIPLIER + increment;
+	uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+	uint32_t rotate = (uint32_t)(old >> 59);
+	return (xorshifted >> rotate) | (xorshifted << (-rotate & 31));
+}
+
+//Any seed and stream are fine, the top bit of stream is dropped
+static inline void rng_seed(uint64_t *state, uint64_t *increment, uint64_t seed, uint64_t stream) {
+	*state = 0;
+	*increment = stream << 1 | 1;
+	rng_next(state, *increment);
+	*state += seed;
+	rng_next(state, *increment);
+}
+
+#endif /* rng_h */
@@ -0,0 +1,207 @@
+//
+//  savestate.c
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "savestate.h"
+#include "crc32.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifndef WINDOWS
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define SAVESTATE_MAGIC "C8SS"
+
+#define STATE_FLAG_RUNNING   0x1
+#define STATE_FLAG_WALLCLOCK 0x2
+
+//Little-endian field writers and readers, each one moves the cursor past the field
+static void put16(byte **p, uint16_t value) {
+	(*p)[0] = value;
+	(*p)[1] = value >> 8;
+	*p += 2;
+}
+
+static void put32(byte **p, uint32_t value) {
+	put16(p, value);
+	put16(p, value >> 16);
+}
+
+static void put64(byte **p, uint64_t value) {
+	put32(p, (uint32_t)value);
+	put32(p, (uint32_t)(value >> 32));
+}
+
+static uint16_t get16(const byte **p) {
+	uint16_t value = (*p)[0] | (*p)[1] << 8;
+	*p += 2;
+	return value;
+}
+
+static uint32_t get32(const byte **p) {
+	uint32_t low = get16(p);
+	return low | (uint32_t)get16(p) << 16;
+}
+
+static uint64_t get64(const byte **p) {
+	uint64_t low = get32(p);
+	return low | (uint64_t)get32(p) << 32;
+}
+
+size_t savestate_write(chipCPU *cpu, byte *buffer) {
+	//Timers are brought up to date lazily, settle them so the state holds what a program would read
+	cpu_update_timers(cpu);
+	
+	byte *p = buffer + SAVESTATE_HEADER_SIZE;
+	memcpy(p, cpu->memory, MEMORY_SIZE);
+	p += MEMORY_SIZE;
+	for (int r = 0; r < DISPLAY_HEIGHT; ++r) put64(&p, cpu->display[r]);
+	memcpy(p, cpu->V, 16);
+	p += 16;
+	for (int s = 0; s < 16; ++s) put16(&p, cpu->stack[s]);
+	put16(&p, cpu->I);
+	put16(&p, cpu->progCounter);
+	put16(&p, cpu->stackPointer);
+	put16(&p, cpu->keys);
+	*p++ = cpu->delay_timer;
+	*p++ = cpu->sound_timer;
+	*p++ = cpu->quirks;
+	*p++ = (cpu->running ? STATE_FLAG_RUNNING : 0) | (cpu->timerMode == timerModeWallClock ? STATE_FLAG_WALLCLOCK : 0);
+	put32(&p, cpu->cyclesPerTick);
+	put64(&p, cpu->cycles);
+	put64(&p, cpu->idleCycles);
+	put64(&p, cpu->rngState);
+	put64(&p, cpu->rngIncrement);
+	
+	byte *h = buffer;
+	memcpy(h, SAVESTATE_MAGIC, 4);
+	h += 4;
+	put16(&h, SAVESTATE_VERSION);
+	put16(&h, SAVESTATE_HEADER_SIZE);
+	put32(&h, SAVESTATE_PAYLOAD_SIZE);
+	put32(&h, crc32(buffer + SAVESTATE_HEADER_SIZE, SAVESTATE_PAYLOAD_SIZE));
+	return SAVESTATE_SIZE;
+}
+
+int savestate_read(chipCPU *cpu, const byte *buffer, size_t size) {
+	if (size < SAVESTATE_SIZE || memcmp(buffer, SAVESTATE_MAGIC, 4) != 0) return -2;
+	const byte *h = buffer + 4;
+	uint16_t version = get16(&h);
+	uint16_t headerSize = get16(&h);
+	uint32_t payloadSize = get32(&h);
+	uint32_t crc = get32(&h);
+	if (version != SAVESTATE_VERSION || headerSize != SAVESTATE_HEADER_SIZE || payloadSize != SAVESTATE_PAYLOAD_SIZE) return -2;
+	if (crc32(buffer + SAVESTATE_HEADER_SIZE, SAVESTATE_PAYLOAD_SIZE) != crc) return -3;
+	
+	//Check the fields that could send the CPU off the end of an array before touching it
+	//Instructions are two bytes, so the PC and return addresses go up to MEMORY_SIZE - 2, and FX33/FX55/FX65 index from I.
+	const byte *payload = buffer + SAVESTATE_HEADER_SIZE;
+	const byte *p = payload + 0x1110;
+	for (int s = 0; s < 16; ++s) {
+		if (get16(&p) > MEMORY_SIZE - 2) return -2;
+	}
+	uint16_t I = get16(&p);
+	uint16_t progCounter = get16(&p);
+	uint16_t stackPointer = get16(&p);
+	byte quirks = payload[0x113A];
+	p = payload + 0x113C;
+	uint32_t cyclesPerTick = get32(&p);
+	if (progCounter > MEMORY_SIZE - 2 || I > 0xFFF || stackPointer > 16 || quirks >= quirkProfileCount || cyclesPerTick == 0) return -2;
+	
+	p = payload;
+	memcpy(cpu->memory, p, MEMORY_SIZE);
+	p += MEMORY_SIZE;
+	for (int r = 0; r < DISPLAY_HEIGHT; ++r) cpu->display[r] = get64(&p);
+	memcpy(cpu->V, p, 16);
+	p += 16;
+	for (int s = 0; s < 16; ++s) cpu->stack[s] = get16(&p);
+	cpu->I = get16(&p);
+	cpu->progCounter = get16(&p);
+	cpu->stackPointer = get16(&p);
+	cpu->keys = get16(&p);
+	cpu->delay_timer = *p++;
+	cpu->sound_timer = *p++;
+	p++; //Quirks, set below
+	byte flags = *p++;
+	p += 4; //Cycles per tick, checked above
+	cpu->cycles = get64(&p);
+	cpu->idleCycles = get64(&p);
+	cpu->rngState = get64(&p);
+	cpu->rngIncrement = get64(&p);
+	cpu->running = flags & STATE_FLAG_RUNNING;
+	
+	//Everything derived from memory goes, and the whole display gets redrawn
+	cpu_set_quirks(cpu, quirks);
+	cpu_invalidate_code(cpu, 0, MEMORY_SIZE);
+	cpu->drawFlag = true;
+	cpu->dirtyRows = 0xFFFFFFFF;
+	cpu->cycleLimit = cpu->cycles;
+	cpu->idle.pc = IDLE_NONE;
+	//Line the timer clock up with the restored cycles first, so switching modes doesn't tick anything.
+	//Wall clock timers carry on from now, the time spent saved doesn't count.
+	cpu->timerMode = timerModeCycles;
+	cpu->cyclesPerTick = cyclesPerTick;
+	cpu->timerTick = cpu->cycles / cyclesPerTick;
+	cpu_set_timer_mode(cpu, flags & STATE_FLAG_WALLCLOCK ? timerModeWallClock : timerModeCycles, cyclesPerTick);
+	return 0;
+}
+
+int savestate_save_file(chipCPU *cpu, const char *path) {
+	byte buffer[SAVESTATE_SIZE];
+	size_t size = savestate_write(cpu, buffer);
+#ifdef WINDOWS
+	FILE *file = fopen(path, "wb");
+	if (!file) return -1;
+	bool written = fwrite(buffer, 1, size, file) == size;
+	return fclose(file) == 0 && written ? 0 : -1;
+#else
+	char temp[4096];
+	if (snprintf(temp, sizeof(temp), "%s.tmp", path) >= (int)sizeof(temp)) return -1;
+	int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) return -1;
+	bool written = write(fd, buffer, size) == (ssize_t)size && fsync(fd) == 0;
+	if (close(fd) != 0 || !written || rename(temp, path) != 0) {
+		unlink(temp);
+		return -1;
+	}
+	return 0;
+#endif
+}
+
+int savestate_load_file(chipCPU *cpu, const char *path) {
+#ifdef WINDOWS
+	FILE *file = fopen(path, "rb");
+	if (!file) return -1;
+	byte buffer[SAVESTATE_SIZE];
+	size_t size = fread(buffer, 1, sizeof(buffer), file);
+	fclose(file);
+	return savestate_read(cpu, buffer, size);
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return -1;
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		return -1;
+	}
+	//Too short to be a state, and mapping nothing fails
+	if (info.st_size < SAVESTATE_SIZE) {
+		close(fd);
+		return -2;
+	}
+	const byte *mapped = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapped == MAP_FAILED) return -1;
+	int result = savestate_read(cpu, mapped, info.st_size);
+	munmap((void *)mapped, info.st_size);
+	return result;
+#endif
+}
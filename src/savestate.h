@@ -0,0 +1,54 @@
+//
+//  savestate.h
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#ifndef savestate_h
+#define savestate_h
+
+#include <stddef.h>
+#include "CPU.h"
+
+//Save states, everything needed to carry on running a machine somewhere else.
+//All fields are little-endian at fixed offsets, so a state written on one host loads on any other.
+//
+//Header, 16 bytes
+// 0x00 "C8SS"
+// 0x04 u16 version
+// 0x06 u16 header size
+// 0x08 u32 payload size
+// 0x0C u32 CRC-32 of the payload
+//Payload
+// 0x0000 memory, 4096 bytes
+// 0x1000 display, 32 u64 rows, leftmost pixel in the most significant bit
+// 0x1100 V0-VF
+// 0x1110 stack, 16 u16
+// 0x1130 u16 I, u16 PC, u16 stack pointer, u16 key mask
+// 0x1138 u8 delay timer, u8 sound timer, u8 quirk profile, u8 flags (bit 0 running, bit 1 wall clock timers)
+// 0x113C u32 cycles per timer tick
+// 0x1140 u64 cycles, u64 idle cycles
+// 0x1150 u64 RNG state, u64 RNG increment
+#define SAVESTATE_VERSION 2
+#define SAVESTATE_HEADER_SIZE 16
+#define SAVESTATE_PAYLOAD_SIZE 0x1160
+#define SAVESTATE_SIZE (SAVESTATE_HEADER_SIZE + SAVESTATE_PAYLOAD_SIZE)
+
+//Serialise the CPU into buffer, which has room for SAVESTATE_SIZE bytes. Returns SAVESTATE_SIZE.
+size_t savestate_write(chipCPU *cpu, byte *buffer);
+
+//Restore the CPU from a state. Translated code and decode caches are dropped, the JIT setting is kept.
+//Returns 0 on success, -2 if it isn't a state this version can read, -3 if the CRC doesn't match.
+//The CPU is left alone unless it succeeds.
+int savestate_read(chipCPU *cpu, const byte *buffer, size_t size);
+
+//Write a state to path with a single write(), through a temporary file that replaces it,
+//so a crash halfway leaves the old state in place. Returns 0 on success, -1 if it can't be written.
+int savestate_save_file(chipCPU *cpu, const char *path);
+
+//Map a state file and restore from it. Returns -1 if it can't be read, otherwise as savestate_read().
+int savestate_load_file(chipCPU *cpu, const char *path);
+
+#endif /* savestate_h */
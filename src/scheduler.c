@@ -0,0 +1,94 @@
+//
+//  scheduler.c
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "scheduler.h"
+#include "timing.h"
+#include "CPU.h"
+#include "chip8.h"
+#include "metrics.h"
+
+void scheduler_init(struct scheduler *s, bool uncapped) {
+	s->uncapped = uncapped;
+	s->frameLength = NSEC_PER_SEC / FRAME_RATE;
+	s->startTime = time_now_ns();
+	s->nextDeadline = s->startTime + s->frameLength;
+	s->frames = 0;
+	s->cycles = 0;
+	s->idleCycles = 0;
+	s->overruns = 0;
+	s->driftTotal = 0;
+	s->driftMax = 0;
+	s->metrics = NULL;
+	s->lastWake = s->startTime;
+	s->frameCycles = 0;
+}
+
+void scheduler_set_metrics(struct scheduler *s, struct metrics *m) {
+	s->metrics = m;
+	s->lastWake = time_now_ns();
+}
+
+bool scheduler_run_frame(struct scheduler *s, struct chip8 *machine) {
+	unsigned long long idle = chip8_idle_cycles(machine);
+	s->frameCycles = chip8_step_frame(machine);
+	s->cycles += s->frameCycles;
+	s->idleCycles += chip8_idle_cycles(machine) - idle;
+	return !chip8_halted(machine);
+}
+
+//Time since the last frame ended, and how fast this one ran
+static void record_frame(struct scheduler *s, long long now) {
+	long long frameTime = now - s->lastWake;
+	s->lastWake = now;
+	metrics_record(s->metrics, metricFrameTime, frameTime);
+	if (frameTime > 0) metrics_record(s->metrics, metricIPS, (uint64_t)s->frameCycles * NSEC_PER_SEC / frameTime);
+}
+
+void scheduler_wait(struct scheduler *s) {
+	s->frames++;
+	if (s->uncapped) {
+		if (s->metrics) record_frame(s, time_now_ns());
+		return;
+	}
+	
+	time_sleep_until_ns(s->nextDeadline);
+	long long now = time_now_ns();
+	long long drift = now - s->nextDeadline;
+	if (drift > 0) {
+		s->driftTotal += drift;
+		if (drift > s->driftMax) s->driftMax = drift;
+	}
+	if (s->metrics) {
+		metrics_record(s->metrics, metricTimerDrift, drift > 0 ? drift : 0);
+		record_frame(s, now);
+	}
+	
+	s->nextDeadline += s->frameLength;
+	//If we fell more than a frame behind (debugger, suspended process), resync instead of trying to catch up
+	if (now > s->nextDeadline) {
+		s->overruns++;
+		s->nextDeadline = now + s->frameLength;
+	}
+}
+
+void scheduler_print_stats(struct scheduler *s) {
+	long long elapsed = time_now_ns() - s->startTime;
+	double seconds = (double)elapsed / NSEC_PER_SEC;
+	printf("%llu frames, %llu cycles in %.2fs", s->frames, s->cycles, seconds);
+	if (seconds > 0) {
+		printf(" (%.1f fps, %.0f instructions/sec)", s->frames / seconds, s->cycles / seconds);
+	}
+	printf("\n");
+	if (s->idleCycles) {
+		printf("%.1f%% of cycles fast-forwarded through idle loops\n", 100.0 * s->idleCycles / s->cycles);
+	}
+	if (!s->uncapped && s->frames) {
+		printf("Frame drift: mean %.1fus, max %.1fus, %llu overruns\n",
+			   (double)s->driftTotal / s->frames / 1000.0, (double)s->driftMax / 1000.0, s->overruns);
+	}
+}
@@ -0,0 +1,55 @@
+//
+//  scheduler.h
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#ifndef scheduler_h
+#define scheduler_h
+
+#include <stdbool.h>
+
+#define FRAME_RATE 60
+
+struct chip8;
+struct metrics;
+
+//Runs a batch of CPU cycles per 60Hz frame, then sleeps once to the next frame deadline.
+struct scheduler {
+	//Uncapped mode never sleeps, for benchmarking
+	bool uncapped;
+	
+	long long frameLength; //ns
+	long long startTime;
+	long long nextDeadline;
+	
+	//Stats
+	unsigned long long frames;
+	unsigned long long cycles;
+	unsigned long long idleCycles; //Of those, fast-forwarded through idle loops
+	unsigned long long overruns; //Frames where we woke up over a frame late and resynced
+	long long driftTotal;		 //Sum of wakeup lateness, ns
+	long long driftMax;
+	
+	//Frame time, instructions per second and drift go here too when it's set, see metrics.h
+	struct metrics *metrics;
+	long long lastWake;
+	int frameCycles;
+};
+
+void scheduler_init(struct scheduler *s, bool uncapped);
+
+//Record every frame's metrics into m from here on, NULL to stop
+void scheduler_set_metrics(struct scheduler *s, struct metrics *m);
+
+//Run one frame worth of cycles. Returns false if the CPU halted.
+bool scheduler_run_frame(struct scheduler *s, struct chip8 *machine);
+
+//Sleep until the next frame deadline, and record how late we woke up
+void scheduler_wait(struct scheduler *s);
+
+void scheduler_print_stats(struct scheduler *s);
+
+#endif /* scheduler_h */
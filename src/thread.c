@@ -0,0 +1,72 @@
+//
+//  thread.c
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "thread.h"
+#include <stdio.h>
+
+#ifndef WINDOWS
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+// Multiplatform thread stub
+#ifdef WINDOWS
+static DWORD WINAPI threadStub(LPVOID arg) {
+	((struct thread *)arg)->threadFunc(arg);
+	return 0;
+}
+#else
+static void *threadStub(void *arg) {
+	return ((struct thread *)arg)->threadFunc(arg);
+}
+#endif
+
+void checkThread(struct thread *t) {
+#ifdef WINDOWS
+	WaitForSingleObjectEx(t->thread_handle, INFINITE, FALSE);
+	CloseHandle(t->thread_handle);
+#else
+	if (pthread_join(t->thread_id, NULL)) {
+		printf("Thread %i frozen.", t->thread_num);
+	}
+#endif
+}
+
+int startThread(struct thread *t) {
+#ifdef WINDOWS
+	t->thread_handle = CreateThread(NULL, 0, threadStub, t, 0, &t->thread_id);
+	if (t->thread_handle == NULL) return -1;
+	return 0;
+#else
+	pthread_attr_t attribs;
+	pthread_attr_init(&attribs);
+	pthread_attr_setdetachstate(&attribs, PTHREAD_CREATE_JOINABLE);
+	int ret = pthread_create(&t->thread_id, &attribs, threadStub, t);
+	pthread_attr_destroy(&attribs);
+	return ret;
+#endif
+}
+
+void yieldThread() {
+#ifdef WINDOWS
+	SwitchToThread();
+#else
+	sched_yield();
+#endif
+}
+
+int getSysCores() {
+#ifdef WINDOWS
+	SYSTEM_INFO sysInfo;
+	GetSystemInfo(&sysInfo);
+	return sysInfo.dwNumberOfProcessors;
+#else
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	return cores > 0 ? (int)cores : 1;
+#endif
+}
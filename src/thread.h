@@ -0,0 +1,45 @@
+//
+//  thread.h
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#ifndef thread_h
+#define thread_h
+
+#include <stdbool.h>
+
+#ifdef WINDOWS
+#include <Windows.h>
+#else
+#include <pthread.h>
+#endif
+
+struct thread {
+#ifdef WINDOWS
+	HANDLE thread_handle;
+	DWORD thread_id;
+#else
+	pthread_t thread_id;
+#endif
+	int thread_num;
+	bool threadComplete;
+	void *(*threadFunc)(void *);
+	void *userData;
+};
+
+//Start t->threadFunc on a new thread, it gets t as its argument. Returns 0 on success.
+int startThread(struct thread *t);
+
+//Wait for the thread to finish
+void checkThread(struct thread *t);
+
+//Give up the rest of this thread's time slice
+void yieldThread(void);
+
+//Number of logical cores available
+int getSysCores(void);
+
+#endif /* thread_h */
@@ -0,0 +1,57 @@
+//
+//  timing.c
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "timing.h"
+
+#ifdef WINDOWS
+#include <Windows.h>
+#else
+#include <time.h>
+#include <errno.h>
+#endif
+
+long long time_now_ns() {
+#ifdef WINDOWS
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+	if (frequency.QuadPart == 0) {
+		QueryPerformanceFrequency(&frequency);
+	}
+	QueryPerformanceCounter(&counter);
+	return (long long)((counter.QuadPart / frequency.QuadPart) * NSEC_PER_SEC +
+					   ((counter.QuadPart % frequency.QuadPart) * NSEC_PER_SEC) / frequency.QuadPart);
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+#endif
+}
+
+void time_sleep_until_ns(long long deadline) {
+#ifdef WINDOWS
+	long long remaining = deadline - time_now_ns();
+	if (remaining > 0) {
+		Sleep((DWORD)(remaining / 1000000));
+	}
+#elif __linux__
+	//Absolute deadline, so oversleeping one frame doesn't push back every frame after it
+	struct timespec ts;
+	ts.tv_sec = deadline / NSEC_PER_SEC;
+	ts.tv_nsec = deadline % NSEC_PER_SEC;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+#else
+	//No clock_nanosleep on macOS, fall back to a relative sleep
+	long long remaining = deadline - time_now_ns();
+	if (remaining > 0) {
+		struct timespec ts;
+		ts.tv_sec = remaining / NSEC_PER_SEC;
+		ts.tv_nsec = remaining % NSEC_PER_SEC;
+		nanosleep(&ts, NULL);
+	}
+#endif
+}
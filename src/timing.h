@@ -0,0 +1,20 @@
+//
+//  timing.h
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#ifndef timing_h
+#define timing_h
+
+#define NSEC_PER_SEC 1000000000LL
+
+//Nanoseconds from a monotonic clock. Only differences are meaningful.
+long long time_now_ns(void);
+
+//Sleep until the monotonic clock reaches deadline. Returns immediately if it already has.
+void time_sleep_until_ns(long long deadline);
+
+#endif /* timing_h */
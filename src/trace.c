@@ -0,0 +1,179 @@
+//
+//  trace.c
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "trace.h"
+#include "decode.h"
+#include "timing.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_MAGIC "C8TR"
+
+//Records the writer serialises per fwrite()
+#define WRITE_CHUNK 4096
+
+//How long the writer sleeps when the ring is empty
+#define WRITER_POLL_NS 100000
+
+static void put16(byte *p, uint16_t value) {
+	p[0] = value;
+	p[1] = value >> 8;
+}
+
+static void put64(byte *p, uint64_t value) {
+	for (int i = 0; i < 8; ++i) p[i] = value >> (i * 8);
+}
+
+//The register an instruction leaves its result in
+static byte changed_register(unsigned short op) {
+	switch (opHandlerTable[op]) {
+		case OP_6XNN: case OP_7XNN:
+		case OP_8XY0: case OP_8XY1: case OP_8XY2: case OP_8XY3: case OP_8XY4:
+		case OP_8XY5: case OP_8XY6: case OP_8XY7: case OP_8XYE:
+		case OP_CXNN: case OP_FX07: case OP_FX0A: case OP_FX65:
+			return (op & 0x0F00) >> 8;
+		case OP_DXYN:
+			return 0xF;
+		case OP_ANNN: case OP_FX1E: case OP_FX29: case OP_FX55:
+			return TRACE_REG_I;
+		default:
+			return TRACE_REG_NONE;
+	}
+}
+
+static void push(struct tracer *t, const struct traceRecord *record) {
+	size_t head = atomic_load_explicit(&t->head, memory_order_relaxed);
+	if (head - t->cachedTail == TRACE_RING_RECORDS) {
+		t->cachedTail = atomic_load_explicit(&t->tail, memory_order_acquire);
+		if (head - t->cachedTail == TRACE_RING_RECORDS) {
+			t->stalls++;
+			while (head - t->cachedTail == TRACE_RING_RECORDS) {
+				yieldThread();
+				t->cachedTail = atomic_load_explicit(&t->tail, memory_order_acquire);
+			}
+		}
+	}
+	t->ring[head & (TRACE_RING_RECORDS - 1)] = *record;
+	//Release, so the writer sees the record before the new head
+	atomic_store_explicit(&t->head, head + 1, memory_order_release);
+	t->records++;
+}
+
+//Fill in what the pending instruction changed, now that it has run, and send it off
+static void finish_pending(struct tracer *t, chipCPU *cpu) {
+	if (!t->havePending) return;
+	byte reg = t->pending.reg;
+	if (reg < 16) {
+		t->pending.value = cpu->V[reg];
+	} else if (reg == TRACE_REG_I) {
+		t->pending.value = cpu->I;
+	}
+	push(t, &t->pending);
+	t->havePending = false;
+}
+
+void trace_instruction(chipCPU *cpu) {
+	struct tracer *t = cpu->trace;
+	finish_pending(t, cpu);
+	t->pending.cycle = cpu->cycles;
+	t->pending.pc = cpu->progCounter;
+	t->pending.op = cpu->currentOP;
+	t->pending.reg = changed_register(cpu->currentOP);
+	t->pending.value = 0;
+	t->havePending = true;
+}
+
+//Drains the ring to the file until told to stop and there's nothing left
+static void *writer_thread(void *arg) {
+	struct thread *thread = (struct thread *)arg;
+	struct tracer *t = (struct tracer *)thread->userData;
+	byte out[WRITE_CHUNK * TRACE_RECORD_SIZE];
+	
+	for (;;) {
+		//Stopping is read first, so once it's set the head read after it has every record
+		bool stopping = atomic_load_explicit(&t->stopping, memory_order_acquire);
+		size_t head = atomic_load_explicit(&t->head, memory_order_acquire);
+		size_t tail = atomic_load_explicit(&t->tail, memory_order_relaxed);
+		if (head == tail) {
+			if (stopping) break;
+			time_sleep_until_ns(time_now_ns() + WRITER_POLL_NS);
+			continue;
+		}
+		size_t count = head - tail < WRITE_CHUNK ? head - tail : WRITE_CHUNK;
+		if (!atomic_load_explicit(&t->failed, memory_order_relaxed)) {
+			for (size_t i = 0; i < count; ++i) {
+				const struct traceRecord *r = &t->ring[(tail + i) & (TRACE_RING_RECORDS - 1)];
+				byte *p = out + i * TRACE_RECORD_SIZE;
+				put64(p, r->cycle);
+				put16(p + 0x08, r->pc);
+				put16(p + 0x0A, r->op);
+				p[0x0C] = r->reg;
+				p[0x0D] = 0;
+				put16(p + 0x0E, r->value);
+			}
+			if (fwrite(out, TRACE_RECORD_SIZE, count, t->file) != count) {
+				atomic_store_explicit(&t->failed, true, memory_order_relaxed);
+			}
+		}
+		//Release, so the producer doesn't reuse the slots before they're read
+		atomic_store_explicit(&t->tail, tail + count, memory_order_release);
+	}
+	
+	thread->threadComplete = true;
+	return NULL;
+}
+
+bool trace_start(chipCPU *cpu, const char *path) {
+	if (cpu->trace) trace_stop(cpu);
+	struct tracer *t = calloc(1, sizeof(*t));
+	if (!t) return false;
+	t->ring = malloc(TRACE_RING_RECORDS * sizeof(*t->ring));
+	t->file = fopen(path, "wb");
+	byte header[TRACE_HEADER_SIZE];
+	memcpy(header, TRACE_MAGIC, 4);
+	put16(header + 4, TRACE_VERSION);
+	put16(header + 6, TRACE_RECORD_SIZE);
+	if (!t->ring || !t->file || fwrite(header, 1, sizeof(header), t->file) != sizeof(header)) {
+		if (t->file) fclose(t->file);
+		free(t->ring);
+		free(t);
+		return false;
+	}
+	atomic_init(&t->head, 0);
+	atomic_init(&t->tail, 0);
+	atomic_init(&t->stopping, false);
+	atomic_init(&t->failed, false);
+	t->writer.threadFunc = writer_thread;
+	t->writer.userData = t;
+	if (startThread(&t->writer)) {
+		fclose(t->file);
+		free(t->ring);
+		free(t);
+		return false;
+	}
+	cpu->trace = t;
+	return true;
+}
+
+long long trace_stop(chipCPU *cpu) {
+	struct tracer *t = cpu->trace;
+	if (!t) return 0;
+	finish_pending(t, cpu);
+	atomic_store_explicit(&t->stopping, true, memory_order_release);
+	checkThread(&t->writer);
+	bool failed = atomic_load(&t->failed);
+	if (fclose(t->file) != 0) failed = true;
+	long long records = failed ? -1 : (long long)t->records;
+	if (t->stalls && !cpu->quiet) {
+		printf("Trace: the writer fell behind %llu times, emulation waited on it\n", t->stalls);
+	}
+	free(t->ring);
+	free(t);
+	cpu->trace = NULL;
+	return records;
+}
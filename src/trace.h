@@ -0,0 +1,79 @@
+//
+//  trace.h
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#ifndef trace_h
+#define trace_h
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include "CPU.h"
+#include "thread.h"
+
+//Binary execution trace. While it's on, every instruction run is a 16 byte record in a lock-free ring
+//that a writer thread drains to a file, so the emulation thread never formats or writes anything itself.
+//chip8-trace turns a trace back into text. Tracing runs everything through the interpreter,
+//and fast-forwarded idle loops show up as a gap in the cycle numbers.
+//
+//File, little-endian
+// 0x00 "C8TR"
+// 0x04 u16 version
+// 0x06 u16 record size
+//Records
+// 0x00 u64 cycle, the instruction's number since the machine started
+// 0x08 u16 PC
+// 0x0A u16 opcode
+// 0x0C u8  register the instruction changed, 0x0-0xF for V0-VF, TRACE_REG_I or TRACE_REG_NONE
+// 0x0D u8  reserved, 0
+// 0x0E u16 what that register held after it
+#define TRACE_VERSION 1
+#define TRACE_HEADER_SIZE 8
+#define TRACE_RECORD_SIZE 16
+#define TRACE_REG_I 0x10
+#define TRACE_REG_NONE 0xFF
+
+//Records the ring holds, a power of two
+#define TRACE_RING_RECORDS (1 << 18)
+
+struct traceRecord {
+	uint64_t cycle;
+	uint16_t pc;
+	uint16_t op;
+	byte reg;
+	uint16_t value;
+};
+
+//One producer, the thread running the machine, and one consumer, the writer thread
+struct tracer {
+	struct traceRecord *ring;
+	//Records pushed and written out, counting up forever. Each on its own cache line.
+	_Alignas(64) atomic_size_t head;
+	_Alignas(64) atomic_size_t tail;
+	//Producer only from here on
+	_Alignas(64) size_t cachedTail; //Where tail last was, so the producer rarely has to look
+	//The instruction being run. It's pushed once the next one is fetched, which is when what it changed is known.
+	struct traceRecord pending;
+	bool havePending;
+	unsigned long long records;
+	unsigned long long stalls; //Times the ring was full and the producer waited on the writer
+	
+	FILE *file;
+	struct thread writer;
+	atomic_bool stopping;
+	atomic_bool failed; //A write failed, the rest of the trace is thrown away
+};
+
+//Start tracing into a new file at path. Returns false if the file or the writer thread can't be set up.
+bool trace_start(chipCPU *cpu, const char *path);
+
+//Write out what's left and close the file. Returns the instructions traced, or -1 if writing failed.
+long long trace_stop(chipCPU *cpu);
+
+//Called for every instruction fetched while tracing, once cpu->currentOP and cpu->cycles are updated
+void trace_instruction(chipCPU *cpu);
+
+#endif /* trace_h */
@@ -0,0 +1,114 @@
+//
+//  tracedump.c
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+//chip8-trace, turns a binary execution trace (see trace.h) back into text, one line per instruction:
+//PC:0x200 OP: 0x6A02 0x6XNN: Set VX to NN -> VA=0x02 (cycle 1)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "decode.h"
+#include "trace.h"
+
+//Records read per fread()
+#define READ_CHUNK 4096
+
+static void print_usage(char *name) {
+	printf("Usage: %s [--from <cycle>] [--count <n>] <trace>\n", name);
+}
+
+static uint16_t get16(const byte *p) {
+	return p[0] | p[1] << 8;
+}
+
+static uint64_t get64(const byte *p) {
+	uint64_t value = 0;
+	for (int i = 7; i >= 0; --i) value = value << 8 | p[i];
+	return value;
+}
+
+static void print_record(const byte *p) {
+	uint64_t cycle = get64(p);
+	uint16_t pc = get16(p + 0x08);
+	uint16_t op = get16(p + 0x0A);
+	byte reg = p[0x0C];
+	uint16_t value = get16(p + 0x0E);
+	
+	enum opHandler handler = cpu_decode_handler(op);
+	printf("PC:0x%X OP: 0x%X ", pc, op);
+	if (handler == OP_UNKNOWN) {
+		printf("Unknown opcode: 0x%X", op);
+	} else {
+		printf("0x%s: %s", opPatterns[handler], opDescriptions[handler]);
+	}
+	if (reg < 16) {
+		printf(" -> V%X=0x%02X", reg, value);
+	} else if (reg == TRACE_REG_I) {
+		printf(" -> I=0x%03X", value);
+	}
+	printf(" (cycle %llu)\n", (unsigned long long)cycle);
+}
+
+int main(int argc, char *argv[]) {
+	unsigned long long from = 0;
+	unsigned long long count = 0;
+	char *path = NULL;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--from") == 0 && i + 1 < argc) {
+			from = strtoull(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+			count = strtoull(argv[++i], NULL, 10);
+		} else if (!path) {
+			path = argv[i];
+		} else {
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+	if (!path) {
+		print_usage(argv[0]);
+		return -1;
+	}
+	
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		printf("Couldn't open %s\n", path);
+		return -1;
+	}
+	byte header[TRACE_HEADER_SIZE];
+	if (fread(header, 1, sizeof(header), file) != sizeof(header) || memcmp(header, "C8TR", 4) != 0 ||
+		get16(header + 4) != TRACE_VERSION || get16(header + 6) != TRACE_RECORD_SIZE) {
+		printf("%s isn't a trace this version can read\n", path);
+		fclose(file);
+		return -1;
+	}
+	
+	static byte records[READ_CHUNK * TRACE_RECORD_SIZE];
+	unsigned long long printed = 0;
+	uint64_t lastCycle = 0;
+	size_t read;
+	while ((read = fread(records, TRACE_RECORD_SIZE, READ_CHUNK, file)) > 0) {
+		for (size_t i = 0; i < read; ++i) {
+			const byte *record = records + i * TRACE_RECORD_SIZE;
+			uint64_t cycle = get64(record);
+			//Cycles the idle detector skipped, or the trace was stopped for
+			if (lastCycle && cycle > lastCycle + 1 && cycle >= from) {
+				printf("... %llu cycles not traced ...\n", (unsigned long long)(cycle - lastCycle - 1));
+			}
+			lastCycle = cycle;
+			if (cycle < from) continue;
+			print_record(record);
+			if (count && ++printed == count) {
+				fclose(file);
+				return 0;
+			}
+		}
+	}
+	fclose(file);
+	return 0;
+}
@@ -0,0 +1,44 @@
+//
+//  tribuf.c
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "tribuf.h"
+
+#define FRESH_BIT 0x4
+#define INDEX_MASK 0x3
+
+void tribuf_init(struct tribuf *tb) {
+	memset(tb->frames, 0, sizeof(tb->frames));
+	tb->back = 0;
+	atomic_init(&tb->middle, 1);
+	tb->front = 2;
+	tb->published = 0;
+	atomic_init(&tb->dropped, 0);
+}
+
+struct frame *tribuf_back(struct tribuf *tb) {
+	return &tb->frames[tb->back];
+}
+
+void tribuf_publish(struct tribuf *tb) {
+	tb->frames[tb->back].number = ++tb->published;
+	//Release, so the consumer sees the frame contents before the index
+	unsigned int old = atomic_exchange_explicit(&tb->middle, tb->back | FRESH_BIT, memory_order_acq_rel);
+	if (old & FRESH_BIT) {
+		atomic_fetch_add_explicit(&tb->dropped, 1, memory_order_relaxed);
+	}
+	tb->back = old & INDEX_MASK;
+}
+
+struct frame *tribuf_acquire(struct tribuf *tb) {
+	if (!(atomic_load_explicit(&tb->middle, memory_order_relaxed) & FRESH_BIT)) {
+		return NULL;
+	}
+	unsigned int old = atomic_exchange_explicit(&tb->middle, tb->front, memory_order_acq_rel);
+	tb->front = old & INDEX_MASK;
+	return &tb->frames[tb->front];
+}
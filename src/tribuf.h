@@ -0,0 +1,47 @@
+//
+//  tribuf.h
+//  CHIP8
+//
+//  Created by Valtteri Koskivuori on 17/10/2026.
+//  Copyright © 2016-2026 Valtteri Koskivuori. All rights reserved.
+//
+
+#ifndef tribuf_h
+#define tribuf_h
+
+#include <stdatomic.h>
+#include "CPU.h"
+
+struct frame {
+	uint64_t rows[DISPLAY_HEIGHT];
+	unsigned long long number;
+};
+
+//Lock-free triple buffer for handing frames from the emulation thread to the render thread.
+//The producer always has a back slot to write, the consumer always has a front slot to read,
+//and the latest finished frame waits in the middle slot. Neither side ever waits on the other.
+//One producer and one consumer only.
+struct tribuf {
+	struct frame frames[3];
+	//Index of the middle slot, plus FRESH_BIT if the consumer hasn't picked it up yet
+	atomic_uint middle;
+	unsigned int back;  //Producer only
+	unsigned int front; //Consumer only
+	
+	unsigned long long published; //Producer only
+	//Frames the producer replaced before the consumer got to them
+	atomic_ullong dropped;
+};
+
+void tribuf_init(struct tribuf *tb);
+
+//Slot for the producer to draw the next frame into
+struct frame *tribuf_back(struct tribuf *tb);
+
+//Make the back slot the latest frame
+void tribuf_publish(struct tribuf *tb);
+
+//Latest frame, or NULL if nothing new was published since the last call
+struct frame *tribuf_acquire(struct tribuf *tb);
+
+#endif /* tribuf_h */